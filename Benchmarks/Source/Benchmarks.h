@@ -0,0 +1,88 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Helpers shared by the benchmarks. Each benchmark prints a human-readable
+// summary as it goes, and returns its results as a var, which main() can write
+// out as JSON.
+
+// Where the human-readable summaries go. This is stdout, unless the JSON is
+// going there instead, in which case main() points it at stderr.
+inline std::ostream*& consoleStream ()
+{
+    static std::ostream* stream = &std::cout;
+    return stream;
+}
+
+inline std::ostream& console () { return *consoleStream (); }
+
+// Benchmarks which also check their results count each failed check here, and
+// main() exits with 1 if there were any.
+inline int& numFailedChecks ()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline double ticksToMs (int64 ticks)
+{
+    return Time::highResolutionTicksToSeconds (ticks) * 1000.0;
+}
+
+// A set of timings, in milliseconds, summarised by their percentiles.
+struct Timings
+{
+    std::vector<double> milliseconds;
+
+    void add (double ms) { milliseconds.push_back (ms); }
+
+    // Sorts the timings, if they aren't sorted already.
+    double getPercentile (double percentile)
+    {
+        if (milliseconds.empty ())
+            return 0.0;
+
+        if (! std::is_sorted (milliseconds.begin (), milliseconds.end ()))
+            std::sort (milliseconds.begin (), milliseconds.end ());
+
+        const auto index = jlimit ((size_t) 0, milliseconds.size () - 1,
+                                   (size_t) (percentile / 100.0 * (double) milliseconds.size ()));
+        return milliseconds[index];
+    }
+
+    double getTotal () const
+    {
+        return std::accumulate (milliseconds.begin (), milliseconds.end (), 0.0);
+    }
+
+    void print (const String& name)
+    {
+        if (milliseconds.empty ())
+            return;
+
+        console () << name.paddedRight (' ', 24)
+                   << "  min " << String (getPercentile (0.0), 3) << " ms"
+                   << "  median " << String (getPercentile (50.0), 3) << " ms"
+                   << "  p99 " << String (getPercentile (99.0), 3) << " ms"
+                   << "  max " << String (getPercentile (100.0), 3) << " ms"
+                   << "  (" << (int) milliseconds.size () << " runs)" << std::endl;
+    }
+
+    var toVar ()
+    {
+        auto* object = new DynamicObject ();
+        object->setProperty ("count", (int) milliseconds.size ());
+        object->setProperty ("minMs", getPercentile (0.0));
+        object->setProperty ("p50Ms", getPercentile (50.0));
+        object->setProperty ("p90Ms", getPercentile (90.0));
+        object->setProperty ("p99Ms", getPercentile (99.0));
+        object->setProperty ("maxMs", getPercentile (100.0));
+        return var (object);
+    }
+};
+
+//==============================================================================
+var benchmarkInstantiation ();
+var benchmarkRendering ();
+var benchmarkKernels ();
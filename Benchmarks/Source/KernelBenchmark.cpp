@@ -0,0 +1,525 @@
+#include "Benchmarks.h"
+#include "../../Source/DSP/RenderKernels.h"
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+constexpr int numTrials = 25;
+constexpr int samplesPerTrial = 1 << 15;
+constexpr int sourceLength = 1 << 16;
+
+const double pitchRatios[] { 0.5, 1.0, 2.0, 4.0 };
+
+// Segments are capped at RenderKernels::maxSegmentLength, but are shorter at
+// block boundaries and when a voice is about to finish.
+const int segmentLengths[] { 8, 32, RenderKernels::maxSegmentLength };
+
+// The smoothers and tail-off run once per sample of a block.
+const int blockSizes[] { 32, 128, 512 };
+
+//==============================================================================
+// On Intel, the time stamp counter ticks at a constant rate close to the nominal
+// clock speed, regardless of turbo or power saving. Elsewhere we scale the wall
+// clock time by the nominal clock speed, which amounts to the same thing.
+bool hasCycleCounter ()
+{
+   #if JUCE_INTEL
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+uint64 readCycleCounter ()
+{
+   #if JUCE_INTEL
+    return (uint64) __rdtsc ();
+   #else
+    return (uint64) Time::getHighResolutionTicks ();
+   #endif
+}
+
+double counterToCycles (uint64 counts)
+{
+    if (hasCycleCounter ())
+        return (double) counts;
+
+    return Time::highResolutionTicksToSeconds ((int64) counts) * SystemStats::getCpuSpeedInMegahertz () * 1.0e6;
+}
+
+// Keeps the results of kernels that only return a value from being optimised away.
+volatile float sink = 0.0f;
+
+//==============================================================================
+struct Measurement
+{
+    double cyclesPerSample = 0.0;
+    double minCyclesPerSample = 0.0;
+    double nsPerSample = 0.0;
+};
+
+// Calls 'kernel', which processes 'samplesPerCall' samples each time, until each
+// trial has covered samplesPerTrial samples. Reports the median over all trials,
+// which is less sensitive to interrupts than the mean.
+template <typename Kernel>
+Measurement measure (int samplesPerCall, Kernel&& kernel)
+{
+    const auto callsPerTrial = jmax (1, samplesPerTrial / samplesPerCall);
+    const auto samples = (double) callsPerTrial * samplesPerCall;
+
+    for (auto i = 0; i < callsPerTrial; ++i)
+        kernel ();
+
+    std::vector<double> cycles, nanoseconds;
+
+    for (auto trial = 0; trial < numTrials; ++trial)
+    {
+        const auto startTicks = Time::getHighResolutionTicks ();
+        const auto startCycles = readCycleCounter ();
+
+        for (auto i = 0; i < callsPerTrial; ++i)
+            kernel ();
+
+        const auto endCycles = readCycleCounter ();
+        const auto endTicks = Time::getHighResolutionTicks ();
+
+        cycles.push_back (counterToCycles (endCycles - startCycles) / samples);
+        nanoseconds.push_back (Time::highResolutionTicksToSeconds (endTicks - startTicks) * 1.0e9 / samples);
+    }
+
+    std::sort (cycles.begin (), cycles.end ());
+    std::sort (nanoseconds.begin (), nanoseconds.end ());
+
+    Measurement result;
+    result.cyclesPerSample = cycles[cycles.size () / 2];
+    result.minCyclesPerSample = cycles.front ();
+    result.nsPerSample = nanoseconds[nanoseconds.size () / 2];
+    return result;
+}
+
+var report (const String& kernel, const String& variant, double pitchRatio, int length, const Measurement& m)
+{
+    console () << kernel.paddedRight (' ', 14)
+               << variant.paddedRight (' ', 18)
+               << (pitchRatio > 0.0 ? ("x" + String (pitchRatio, 1)) : String ("-")).paddedLeft (' ', 5)
+               << String (length).paddedLeft (' ', 6)
+               << "  " << String (m.cyclesPerSample, 2).paddedLeft (' ', 8) << " cycles/sample"
+               << "  " << String (m.nsPerSample, 3).paddedLeft (' ', 8) << " ns/sample" << std::endl;
+
+    auto* result = new DynamicObject ();
+    result->setProperty ("kernel", kernel);
+    result->setProperty ("variant", variant);
+
+    if (pitchRatio > 0.0)
+        result->setProperty ("pitchRatio", pitchRatio);
+
+    result->setProperty ("length", length);
+    result->setProperty ("cyclesPerSample", m.cyclesPerSample);
+    result->setProperty ("minCyclesPerSample", m.minCyclesPerSample);
+    result->setProperty ("nsPerSample", m.nsPerSample);
+    return var (result);
+}
+
+//==============================================================================
+// Plain loops that compute the same thing as the kernels, so that the gain from
+// vectorising them can be measured. The compiler is free to vectorise these
+// too, which is exactly what we want to compare against.
+void scalarLinear (const float* in, const RenderKernels::Segment& segment, float* dest)
+{
+    for (auto i = 0; i < segment.length; ++i)
+    {
+        const auto a = in[segment.positions[i]];
+        const auto b = in[segment.positions[i] + 1];
+        dest[i] = (a + segment.fractions[i] * (b - a)) * segment.levels[i];
+    }
+}
+
+void scalarCubic (const float* in, const RenderKernels::Segment& segment, float* dest)
+{
+    for (auto i = 0; i < segment.length; ++i)
+    {
+        const auto* frames = in + segment.positions[i];
+        const auto xm1 = frames[-1], x0 = frames[0], x1 = frames[1], x2 = frames[2];
+        const auto f = segment.fractions[i];
+
+        const auto c1 = 0.5f * (x1 - xm1);
+        const auto c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+        const auto c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+        dest[i] = (((c3 * f + c2) * f + c1) * f + x0) * segment.levels[i];
+    }
+}
+
+void scalarSinc (const float* in, const PolyphaseSincTable& table, const RenderKernels::Segment& segment, float* dest)
+{
+    const auto numTaps = table.getNumTaps ();
+    const auto firstTap = 1 - numTaps / 2;
+
+    for (auto i = 0; i < segment.length; ++i)
+    {
+        const auto scaledPhase = segment.fractions[i] * (float) PolyphaseSincTable::numPhases;
+        const auto phase = jmin ((int) scaledPhase, (int) PolyphaseSincTable::numPhases - 1);
+        const auto blend = scaledPhase - (float) phase;
+
+        const auto* frames = in + segment.positions[i] + firstTap;
+        const auto* lower = table.getPhase (phase);
+        const auto* upper = table.getPhase (phase + 1);
+
+        auto total = 0.0f;
+
+        for (auto tap = 0; tap < numTaps; ++tap)
+            total += frames[tap] * (lower[tap] + blend * (upper[tap] - lower[tap]));
+
+        dest[i] = total * segment.levels[i];
+    }
+}
+
+template <typename Element>
+void scalarAccumulate (Element* dest, const float* src, int num)
+{
+    for (auto i = 0; i < num; ++i)
+        dest[i] += (Element) src[i];
+}
+
+template <typename Element>
+void scalarAccumulateAverage (Element* dest, const float* left, const float* right, int num)
+{
+    for (auto i = 0; i < num; ++i)
+        dest[i] += ((Element) left[i] + (Element) right[i]) * (Element) 0.5;
+}
+
+//==============================================================================
+// White noise, padded so that the widest interpolator can read either side of
+// any position in [0, sourceLength).
+std::vector<float> makeSource ()
+{
+    std::vector<float> source ((size_t) (sourceLength + 2 * maxInterpolationTaps));
+    Random random (1234);
+
+    for (auto& s : source)
+        s = random.nextFloat () * 2.0f - 1.0f;
+
+    return source;
+}
+
+RenderKernels::Segment makeSegment (double pitchRatio, int length)
+{
+    RenderKernels::Segment segment;
+    segment.length = length;
+
+    auto position = 0.25;
+
+    for (auto i = 0; i < length; ++i)
+    {
+        const auto pos = (int) position;
+        segment.positions[i] = pos;
+        segment.fractions[i] = (float) (position - pos);
+        segment.levels[i] = 0.5f;
+        position += pitchRatio;
+    }
+
+    return segment;
+}
+
+//==============================================================================
+// Renders every segment with both the kernel and its scalar reference, at a
+// spread of positions in the source, and returns the largest difference. The
+// levels are all 1, so that this is the error for full-scale input.
+template <typename Render, typename Reference>
+float measureError (const std::vector<float>& source, Render&& render, Reference&& reference)
+{
+    alignas (32) float fromKernel[RenderKernels::maxSegmentLength];
+    alignas (32) float fromReference[RenderKernels::maxSegmentLength];
+    auto maxError = 0.0f;
+
+    for (auto pitchRatio : pitchRatios)
+    {
+        for (auto length : segmentLengths)
+        {
+            auto segment = makeSegment (pitchRatio, length);
+            std::fill (segment.levels, segment.levels + length, 1.0f);
+
+            const auto span = segment.positions[length - 1] + 1;
+
+            for (auto offset = 0; offset + span < sourceLength; offset += sourceLength / 64 + 1)
+            {
+                const auto* in = source.data () + maxInterpolationTaps + offset;
+                render (in, segment, fromKernel);
+                reference (in, segment, fromReference);
+
+                for (auto i = 0; i < length; ++i)
+                    maxError = jmax (maxError, std::abs (fromKernel[i] - fromReference[i]));
+            }
+        }
+    }
+
+    return maxError;
+}
+
+// Kernels which stray further than RenderKernels::maxErrorFromScalar from their
+// references count as failed checks.
+template <typename Render, typename Reference>
+var checkInterpolator (const std::vector<float>& source, const String& name, Render&& render, Reference&& reference)
+{
+    const auto maxError = measureError (source, render, reference);
+    const auto passed = maxError <= RenderKernels::maxErrorFromScalar;
+
+    if (! passed)
+        ++numFailedChecks ();
+
+    console () << ("accuracy " + name).paddedRight (' ', 32)
+               << "  max error " << String (maxError, 9)
+               << (passed ? "" : "  FAILED") << std::endl;
+
+    auto* result = new DynamicObject ();
+    result->setProperty ("kernel", name);
+    result->setProperty ("maxError", maxError);
+    result->setProperty ("passed", passed);
+    return var (result);
+}
+
+void checkInterpolators (Array<var>& results)
+{
+    SincTables tables;
+    tables.prepare ();
+
+    const auto source = makeSource ();
+
+    results.add (checkInterpolator (source, "linear",
+                                    [] (auto* in, auto& s, auto* d) { RenderKernels::renderLinear (in, s, d); },
+                                    [] (auto* in, auto& s, auto* d) { scalarLinear (in, s, d); }));
+    results.add (checkInterpolator (source, "cubic",
+                                    [] (auto* in, auto& s, auto* d) { RenderKernels::renderCubic (in, s, d); },
+                                    [] (auto* in, auto& s, auto* d) { scalarCubic (in, s, d); }));
+
+    for (auto mode : { InterpolationMode::sinc8, InterpolationMode::sinc16, InterpolationMode::sinc32 })
+    {
+        const auto& table = *tables.getTable (mode);
+
+        results.add (checkInterpolator (source, "sinc" + String (getNumTaps (mode)),
+                                        [&] (auto* in, auto& s, auto* d) { RenderKernels::renderSinc (in, table, s, d); },
+                                        [&] (auto* in, auto& s, auto* d) { scalarSinc (in, table, s, d); }));
+    }
+}
+
+//==============================================================================
+template <typename Render>
+void benchmarkInterpolator (Array<var>& results, const std::vector<float>& source, const String& name, Render&& render)
+{
+    alignas (32) float dest[RenderKernels::maxSegmentLength];
+
+    for (auto pitchRatio : pitchRatios)
+    {
+        for (auto length : segmentLengths)
+        {
+            const auto segment = makeSegment (pitchRatio, length);
+
+            // Start each call somewhere else in the source, so that reads aren't
+            // always served from the same few cache lines.
+            auto offset = 0;
+            const auto span = segment.positions[length - 1] + 1;
+
+            const auto m = measure (length, [&]
+            {
+                render (source.data () + maxInterpolationTaps + offset, segment, dest);
+                offset = (offset + span) % (sourceLength - span);
+            });
+
+            results.add (report ("interpolate", name, pitchRatio, length, m));
+        }
+    }
+
+    sink = dest[0];
+}
+
+void benchmarkInterpolators (Array<var>& results)
+{
+    SincTables tables;
+    tables.prepare ();
+
+    const auto source = makeSource ();
+
+    benchmarkInterpolator (results, source, "linear",        [] (auto* in, auto& s, auto* d) { RenderKernels::renderLinear (in, s, d); });
+    benchmarkInterpolator (results, source, "linear scalar", [] (auto* in, auto& s, auto* d) { scalarLinear (in, s, d); });
+    benchmarkInterpolator (results, source, "cubic",         [] (auto* in, auto& s, auto* d) { RenderKernels::renderCubic (in, s, d); });
+    benchmarkInterpolator (results, source, "cubic scalar",  [] (auto* in, auto& s, auto* d) { scalarCubic (in, s, d); });
+
+    for (auto mode : { InterpolationMode::sinc8, InterpolationMode::sinc16, InterpolationMode::sinc32 })
+    {
+        const auto& table = *tables.getTable (mode);
+        const auto name = "sinc" + String (getNumTaps (mode));
+
+        benchmarkInterpolator (results, source, name,             [&] (auto* in, auto& s, auto* d) { RenderKernels::renderSinc (in, table, s, d); });
+        benchmarkInterpolator (results, source, name + " scalar", [&] (auto* in, auto& s, auto* d) { scalarSinc (in, table, s, d); });
+    }
+}
+
+// A stereo source into a stereo output is two calls to accumulate(). A stereo
+// source into a mono output folds both channels down with accumulateAverage().
+template <typename Element>
+void benchmarkMixing (Array<var>& results, const String& elementName)
+{
+    alignas (32) float left[RenderKernels::maxSegmentLength];
+    alignas (32) float right[RenderKernels::maxSegmentLength];
+    alignas (32) Element outL[RenderKernels::maxSegmentLength] {};
+    alignas (32) Element outR[RenderKernels::maxSegmentLength] {};
+
+    for (auto i = 0; i < RenderKernels::maxSegmentLength; ++i)
+    {
+        left[i] = (float) i / RenderKernels::maxSegmentLength;
+        right[i] = -left[i];
+    }
+
+    for (auto length : segmentLengths)
+    {
+        results.add (report ("mix " + elementName, "stereo", 0.0, length, measure (length, [&]
+        {
+            RenderKernels::accumulate (outL, left, length);
+            RenderKernels::accumulate (outR, right, length);
+        })));
+
+        results.add (report ("mix " + elementName, "stereo scalar", 0.0, length, measure (length, [&]
+        {
+            scalarAccumulate (outL, left, length);
+            scalarAccumulate (outR, right, length);
+        })));
+
+        results.add (report ("mix " + elementName, "mono", 0.0, length, measure (length, [&]
+        {
+            RenderKernels::accumulateAverage (outL, left, right, length);
+        })));
+
+        results.add (report ("mix " + elementName, "mono scalar", 0.0, length, measure (length, [&]
+        {
+            scalarAccumulateAverage (outL, left, right, length);
+        })));
+    }
+
+    sink = (float) (outL[0] + outR[0]);
+}
+
+// The voices smooth their level and frequency one sample at a time, with the
+// same ramps as SmoothedValue. Retargeting every block keeps them ramping.
+template <typename Element>
+void benchmarkSmoothing (Array<var>& results, const String& elementName)
+{
+    std::vector<Element> gains ((size_t) blockSizes[numElementsInArray (blockSizes) - 1]);
+    std::vector<float> buffer (gains.size (), 1.0f);
+
+    for (auto blockSize : blockSizes)
+    {
+        SmoothedValue<Element> smoothed;
+        smoothed.reset (48000.0, 0.05);
+        auto target = (Element) 1;
+
+        results.add (report ("smooth " + elementName, "getNextValue", 0.0, blockSize, measure (blockSize, [&]
+        {
+            target = (Element) 1 - target;
+            smoothed.setTargetValue (target);
+
+            for (auto i = 0; i < blockSize; ++i)
+                gains[(size_t) i] = smoothed.getNextValue ();
+        })));
+
+        if constexpr (std::is_same_v<Element, float>)
+        {
+            results.add (report ("smooth " + elementName, "applyGain", 0.0, blockSize, measure (blockSize, [&]
+            {
+                target = 1.0f - target;
+                smoothed.setTargetValue (target);
+                smoothed.applyGain (buffer.data (), blockSize);
+            })));
+        }
+    }
+
+    sink = (float) gains[0] + buffer[0];
+}
+
+// The tail-off in SamplerVoiceBank::prepareSegment() multiplies each sample's
+// gain by a decaying factor, checking after each step whether the voice has
+// faded out. The geometric variant instead scales a precomputed table of powers
+// of the decay, which is what a vectorised version would have to do.
+void benchmarkTailOff (Array<var>& results)
+{
+    constexpr double decay = 0.9999;
+
+    alignas (32) float gains[RenderKernels::maxSegmentLength];
+    alignas (32) float powers[RenderKernels::maxSegmentLength];
+
+    for (auto i = 0; i < RenderKernels::maxSegmentLength; ++i)
+        powers[i] = (float) std::pow (decay, i);
+
+    for (auto length : segmentLengths)
+    {
+        auto tailOff = 1.0;
+
+        results.add (report ("tail-off", "per sample", 0.0, length, measure (length, [&]
+        {
+            for (auto i = 0; i < length; ++i)
+            {
+                gains[i] = (float) (0.5 * tailOff);
+                tailOff *= decay;
+
+                if (tailOff < 0.005)
+                    tailOff = 1.0;
+            }
+        })));
+
+        tailOff = 1.0;
+
+        results.add (report ("tail-off", "geometric", 0.0, length, measure (length, [&]
+        {
+            using RenderKernels::detail::Vec;
+            const auto gain = Vec::broadcast ((float) (0.5 * tailOff));
+
+            RenderKernels::detail::forEachChunk (length,
+                                                 [&] (int n) { Vec::store (gains + n, Vec::mul (gain, Vec::load (powers + n))); },
+                                                 [&] (int n) { gains[n] = (float) (0.5 * tailOff) * powers[n]; });
+
+            tailOff *= (double) powers[length - 1] * decay;
+
+            if (tailOff < 0.005)
+                tailOff = 1.0;
+        })));
+    }
+
+    sink = gains[0];
+}
+} // namespace
+
+// Times the inner loops of the voices in isolation, in cycles per output sample,
+// after checking that the interpolators agree with their scalar references. The
+// thread is pinned to a single core, so that the cycle counter (and the caches)
+// don't change underneath a measurement.
+var benchmarkKernels ()
+{
+    Thread::setCurrentThreadAffinityMask (1);
+
+    console () << "Counting " << (hasCycleCounter () ? "time stamp counter cycles" : "cycles at the nominal clock speed")
+               << ", vector width " << RenderKernels::detail::Vec::width << std::endl;
+
+    Array<var> accuracy, results;
+
+    checkInterpolators (accuracy);
+    benchmarkInterpolators (results);
+    benchmarkMixing<float> (results, "float");
+    benchmarkMixing<double> (results, "double");
+    benchmarkSmoothing<float> (results, "float");
+    benchmarkSmoothing<double> (results, "double");
+    benchmarkTailOff (results);
+
+    auto* result = new DynamicObject ();
+    result->setProperty ("cycleCounter", hasCycleCounter () ? "tsc" : "nominal");
+    result->setProperty ("vectorWidth", RenderKernels::detail::Vec::width);
+    result->setProperty ("maxErrorFromScalar", RenderKernels::maxErrorFromScalar);
+    result->setProperty ("accuracy", accuracy);
+    result->setProperty ("results", results);
+    return var (result);
+}
@@ -0,0 +1,119 @@
+#include "Benchmarks.h"
+#include "../../Source/RealtimeDebug.h"
+#include "../../Source/Trace.h"
+
+//==============================================================================
+// Command-line benchmarks for the sampler.
+//
+//     Benchmarks [--json <file>] [--trace <file>] [benchmark...]
+//
+// Runs the named benchmarks, or all of them if none are named. With --json, the
+// results are also written to the file as JSON, so that runs can be compared
+// between releases. '-' writes the JSON to stdout, and everything else to
+// stderr. With --trace, the last few seconds of each thread's trace events are
+// saved as a Chrome trace, as long as the benchmarks were built with
+// SAMPLER_TRACING=1.
+//
+// Always benchmark a Release build: Debug builds add realtime-safety checks to
+// the audio thread, and aren't optimised.
+//
+// The RealtimeChecks configuration is a Release build which also intercepts
+// allocations, locks and blocking calls on the audio thread. Each violation is
+// logged to stderr, and counted in the results. If there were any, the exit
+// code is 1, so that CI can fail the run. The same goes for any benchmark
+// whose results fail their own checks.
+
+namespace
+{
+struct Benchmark
+{
+    const char* name;
+    var (*run) ();
+};
+
+const Benchmark benchmarks[] {
+    { "instantiation", benchmarkInstantiation },
+    { "render",        benchmarkRendering },
+    { "kernels",       benchmarkKernels },
+};
+} // namespace
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor uses timers and async updates, so it needs a message manager.
+    const ScopedJuceInitialiser_GUI juceInitialiser;
+
+    StringArray requested;
+    String jsonPath, tracePath;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        const String arg (argv[i]);
+
+        if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else
+            requested.add (arg);
+    }
+
+    // Keep stdout machine-readable.
+    if (jsonPath == "-")
+        consoleStream () = &std::cerr;
+
+    auto* results = new DynamicObject ();
+    const var resultsVar (results);
+
+    results->setProperty ("os", SystemStats::getOperatingSystemName ());
+    results->setProperty ("cpu", SystemStats::getCpuModel ());
+    results->setProperty ("numCpus", SystemStats::getNumCpus ());
+    results->setProperty ("time", Time::getCurrentTime ().toISO8601 (true));
+
+    for (const auto& benchmark : benchmarks)
+    {
+        if (requested.isEmpty () || requested.contains (benchmark.name))
+        {
+            console () << "== " << benchmark.name << std::endl;
+            results->setProperty (benchmark.name, benchmark.run ());
+        }
+    }
+
+    auto* violations = new DynamicObject ();
+    auto* permitted = new DynamicObject ();
+
+    for (auto i = 0; i < RealtimeDebug::numViolationTypes; ++i)
+    {
+        const auto type = (RealtimeDebug::Violation) i;
+        const auto count = RealtimeDebug::getNumViolations (type);
+        violations->setProperty (RealtimeDebug::getViolationName (type), count);
+        permitted->setProperty (RealtimeDebug::getViolationName (type), RealtimeDebug::getNumPermittedViolations (type));
+
+        if (count > 0)
+            console () << "!! " << count << " realtime violation(s): " << RealtimeDebug::getViolationName (type) << std::endl;
+    }
+
+    results->setProperty ("realtimeChecks", RealtimeDebug::areChecksEnabled ());
+    results->setProperty ("realtimeViolations", var (violations));
+    results->setProperty ("permittedRealtimeViolations", var (permitted));
+
+    if (tracePath.isNotEmpty () && ! Trace::isEnabled ())
+    {
+        console () << "Tracing isn't compiled in, so there's no trace to save" << std::endl;
+    }
+    else if (tracePath.isNotEmpty ())
+    {
+        const auto traceFile = File::getCurrentWorkingDirectory ().getChildFile (tracePath);
+        traceFile.deleteFile ();
+        FileOutputStream out (traceFile);
+        Trace::write (out);
+    }
+
+    if (jsonPath == "-")
+        std::cout << JSON::toString (resultsVar) << std::endl;
+    else if (jsonPath.isNotEmpty ())
+        File::getCurrentWorkingDirectory ().getChildFile (jsonPath).replaceWithText (JSON::toString (resultsVar));
+
+    return RealtimeDebug::getTotalViolations () > 0 || numFailedChecks () > 0 ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+#include "Benchmarks.h"
+#include "../../Source/SamplerAudioProcessor.h"
+
+namespace
+{
+constexpr double sampleRate = 48000.0;
+constexpr double secondsPerRun = 2.0;
+constexpr int midiChannels = 16;
+
+// A scripted performance. Every voice is started at once, and held for the
+// whole run, while the controllers (if any) move continuously.
+struct Scenario
+{
+    const char* name;
+    int numVoices;
+    int pitchbendInterval;  // In samples, or 0 for no pitchbend.
+    int pressureInterval;   // In samples, or 0 for no pressure.
+};
+
+const Scenario scenarios[] {
+    { "1 voice",             1,   0,  0 },
+    { "16 voices",           16,  0,  0 },
+    { "64 voices",           64,  0,  0 },
+    { "200 voices",          200, 0,  0 },
+    { "16 voices pitchbend", 16,  32, 0 },
+    { "16 voices pressure",  16,  0,  32 },
+};
+
+const int blockSizes[] { 32, 64, 128, 256, 512, 1024 };
+
+// Ten seconds of a stereo tone with a few harmonics, encoded as a WAV file.
+// Even two octaves up, that outlasts a run.
+MemoryBlock makeTestSample ()
+{
+    const auto numFrames = (int) (sampleRate * 10.0);
+    AudioBuffer<float> audio (2, numFrames);
+
+    for (auto i = 0; i < numFrames; ++i)
+    {
+        const auto phase = MathConstants<double>::twoPi * 220.0 * i / sampleRate;
+        const auto value = (float) (0.5 * std::sin (phase) + 0.25 * std::sin (2.0 * phase) + 0.125 * std::sin (3.0 * phase));
+        audio.setSample (0, i, value);
+        audio.setSample (1, i, value * 0.9f);
+    }
+
+    MemoryBlock data;
+    WavAudioFormat format;
+    std::unique_ptr<AudioFormatWriter> writer (format.createWriterFor (new MemoryOutputStream (data, false),
+                                                                       sampleRate, 2, 24, {}, 0));
+    writer->writeFromAudioSampleBuffer (audio, 0, numFrames);
+    writer = nullptr;  // Flushes the stream.
+    return data;
+}
+
+void waitForLoad (SamplerAudioProcessor& processor)
+{
+    // The loaded sample is handed over on the message thread, which is this one.
+    while (processor.isLoadingSample ())
+        MessageManager::getInstance ()->runDispatchLoopUntil (5);
+}
+
+// Spreads the voices over the channels, so that no channel has more than a
+// couple of dozen notes on it.
+MidiMessage noteOnForVoice (int voice)
+{
+    return MidiMessage::noteOn (voice % midiChannels + 1, 36 + (voice / midiChannels) * 2, (uint8) 100);
+}
+
+void addControllers (const Scenario& scenario, MidiBuffer& midi, int64 startSample, int numSamples)
+{
+    for (auto i = 0; i < numSamples; ++i)
+    {
+        const auto sample = startSample + i;
+        const auto sweep = 0.5 + 0.5 * std::sin (MathConstants<double>::twoPi * 0.5 * (double) sample / sampleRate);
+
+        for (auto channel = 1; channel <= midiChannels; ++channel)
+        {
+            if (scenario.pitchbendInterval > 0 && sample % scenario.pitchbendInterval == 0)
+                midi.addEvent (MidiMessage::pitchWheel (channel, roundToInt (sweep * 16383.0)), i);
+
+            if (scenario.pressureInterval > 0 && sample % scenario.pressureInterval == 0)
+                midi.addEvent (MidiMessage::channelPressureChange (channel, roundToInt (sweep * 127.0)), i);
+        }
+    }
+}
+
+var runScenario (const MemoryBlock& sampleData, const Scenario& scenario, int blockSize)
+{
+    SamplerAudioProcessor processor;
+    processor.setSample (std::make_unique<MemoryAudioFormatReaderFactory> (sampleData.getData (), sampleData.getSize ()));
+    waitForLoad (processor);
+
+    // Legacy mode puts every channel's notes on the same footing, so the
+    // controllers reach every voice.
+    processor.setLegacyModeEnabled (2, { 1, midiChannels + 1 });
+    processor.setVoiceStealingEnabled (false);
+    processor.setNumberOfVoices (scenario.numVoices);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    AudioBuffer<float> buffer (2, blockSize);
+    MidiBuffer midi;
+
+    // The first block applies the commands above, and the second starts the
+    // notes. Neither is timed.
+    processor.processBlock (buffer, midi);
+
+    for (auto voice = 0; voice < scenario.numVoices; ++voice)
+        midi.addEvent (noteOnForVoice (voice), 0);
+
+    processor.processBlock (buffer, midi);
+
+    const auto numBlocks = (int) (secondsPerRun * sampleRate / blockSize);
+    Timings blockTimes;
+    int64 totalActiveVoices = 0;
+
+    for (auto block = 0; block < numBlocks; ++block)
+    {
+        midi.clear ();
+        addControllers (scenario, midi, (int64) (block + 2) * blockSize, blockSize);
+
+        const auto start = Time::getHighResolutionTicks ();
+        processor.processBlock (buffer, midi);
+        blockTimes.add (ticksToMs (Time::getHighResolutionTicks () - start));
+
+        totalActiveVoices += processor.getPlaybackSnapshot ().numActiveVoices;
+    }
+
+    processor.releaseResources ();
+
+    const auto numSamples = (double) numBlocks * blockSize;
+    const auto wallSeconds = blockTimes.getTotal () / 1000.0;
+    const auto averageVoices = (double) totalActiveVoices / numBlocks;
+    const auto nsPerSamplePerVoice = averageVoices > 0.0 ? wallSeconds * 1.0e9 / (numSamples * averageVoices) : 0.0;
+    const auto realTimeFactor = wallSeconds > 0.0 ? (numSamples / sampleRate) / wallSeconds : 0.0;
+
+    console () << String (scenario.name).paddedRight (' ', 22)
+               << String (blockSize).paddedLeft (' ', 5) << " samples"
+               << "  " << String (nsPerSamplePerVoice, 2).paddedLeft (' ', 8) << " ns/sample/voice"
+               << "  " << String (realTimeFactor, 1).paddedLeft (' ', 8) << "x realtime"
+               << "  p99 " << String (blockTimes.getPercentile (99.0) * 1000.0, 1) << " us" << std::endl;
+
+    auto* result = new DynamicObject ();
+    result->setProperty ("scenario", scenario.name);
+    result->setProperty ("blockSize", blockSize);
+    result->setProperty ("requestedVoices", scenario.numVoices);
+    result->setProperty ("averageActiveVoices", averageVoices);
+    result->setProperty ("nsPerSamplePerVoice", nsPerSamplePerVoice);
+    result->setProperty ("realTimeFactor", realTimeFactor);
+    result->setProperty ("blockTimes", blockTimes.toVar ());
+    return var (result);
+}
+} // namespace
+
+// Renders each scenario offline at each block size, as fast as possible.
+var benchmarkRendering ()
+{
+    const auto sampleData = makeTestSample ();
+    Array<var> results;
+
+    for (const auto& scenario : scenarios)
+        for (auto blockSize : blockSizes)
+            results.add (runScenario (sampleData, scenario, blockSize));
+
+    return results;
+}
@@ -0,0 +1,30 @@
+#include "Benchmarks.h"
+#include "../../Source/SamplerAudioProcessor.h"
+
+// How long a host waits for a new instance, and how long it takes to get rid
+// of one. Neither should involve loading a sample.
+var benchmarkInstantiation ()
+{
+    constexpr int numInstances = 50;
+    Timings construction, destruction;
+
+    for (auto i = 0; i < numInstances; ++i)
+    {
+        const auto start = Time::getHighResolutionTicks ();
+        auto processor = std::make_unique<SamplerAudioProcessor> ();
+        const auto constructed = Time::getHighResolutionTicks ();
+        processor = nullptr;
+        const auto destroyed = Time::getHighResolutionTicks ();
+
+        construction.add (ticksToMs (constructed - start));
+        destruction.add (ticksToMs (destroyed - constructed));
+    }
+
+    construction.print ("construct instance");
+    destruction.print ("destroy instance");
+
+    auto* result = new DynamicObject ();
+    result->setProperty ("construct", construction.toVar ());
+    result->setProperty ("destroy", destruction.toVar ());
+    return var (result);
+}
@@ -3,6 +3,9 @@
 #include "juceHeader.h"
 using namespace juce;
 
+#include "RealtimeDebug.h"
+#include "Trace.h"
+
 // We want to send type-erased commands to the audio thread, but we also
 // want those commands to contain move-only resources, so that we can
 // construct resources on the gui thread, and then transfer ownership
@@ -12,7 +15,7 @@ using namespace juce;
 template <typename Proc>
 struct Command
 {
-    virtual ~Command () noexcept = default;
+    virtual ~Command () noexcept { RealtimeDebug::noteDestruction (); }
     virtual void run (Proc& proc) = 0;
 };
 
@@ -32,16 +35,25 @@ public:
     void run (Proc& proc) override { (*this) (proc); }
 };
 
-//=========================================================================
-
+// A single-producer, single-consumer queue of commands, with each command
+// constructed directly into a fixed-size slot. Pushing never allocates.
+//
+// Commands are run on the audio thread, but destroyed on the message thread:
+// a slot isn't reused until the producer has reclaimed the command in it,
+// which happens before each push, and periodically on a timer. That way,
+// anything a command still owns after it has run is freed off the audio thread.
 template <typename Proc>
-class CommandFifo final
+class CommandFifo final : private Timer
 {
 public:
-    explicit CommandFifo (int size)
-        : buffer ((size_t) size),
-        abstractFifo (size)
+    // Every command must fit into this many bytes. push() checks at compile time.
+    enum { inlineSize = 192 };
+
+    explicit CommandFifo (int capacity)
+        : slots ((size_t) nextPowerOfTwo (capacity)),
+        mask ((uint32) slots.size () - 1)
     {
+        startTimer (100);
     }
 
     CommandFifo ()
@@ -49,33 +61,119 @@ public:
     {
     }
 
+    ~CommandFifo () override
+    {
+        stopTimer ();
+
+        for (auto& slot : slots)
+            if (slot.command != nullptr)
+                std::destroy_at (slot.command);
+    }
+
+    // Message thread only. If the fifo is full, this waits for the audio thread
+    // to make room. If it doesn't within a second (probably because audio isn't
+    // running), the command is dropped, and this returns false.
     template <typename Item>
-    void push (Item&& item) noexcept
+    bool push (Item&& item)
     {
-        auto command = makeCommand (std::forward<Item> (item));
+        using Decayed = std::decay_t<Item>;
+        using Concrete = TemplateCommand<Proc, Decayed>;
 
-        abstractFifo.write (1).forEach ([&](int index)
-                                        {
-                                            buffer[size_t (index)] = std::move (command);
-                                        });
+        static_assert (sizeof (Concrete) <= inlineSize, "This command is too big for a CommandFifo slot");
+        static_assert (alignof (Concrete) <= alignof (std::max_align_t), "This command is over-aligned");
+
+        reclaim ();
+
+        if (isFull ())
+            waitForSpace ();
+
+        if (isFull ())
+        {
+            ++numDropped;
+            return false;
+        }
+
+        auto& slot = slots[(size_t) (writeIndex & mask)];
+        slot.command = new (slot.storage) Concrete (std::forward<Item> (item));
+
+        writtenIndex.store (++writeIndex, std::memory_order_release);
+        highWaterMark = jmax (highWaterMark, (int) (writeIndex - readIndex.load (std::memory_order_relaxed)));
+        return true;
     }
 
-    void call (Proc& proc) noexcept
+    // Audio thread only. Runs every pending command, in order, and returns the
+    // number that were run.
+    int call (Proc& proc) noexcept
     {
-        abstractFifo.read (abstractFifo.getNumReady ()).forEach ([&](int index)
-                                                                 {
-                                                                     buffer[size_t (index)]->run (proc);
-                                                                 });
+        SAMPLER_TRACE_SCOPE ("CommandFifo::call");
+
+        const auto start = readIndex.load (std::memory_order_relaxed);
+        const auto end = writtenIndex.load (std::memory_order_acquire);
+
+        for (auto index = start; index != end; ++index)
+        {
+            slots[(size_t) (index & mask)].command->run (proc);
+            readIndex.store (index + 1, std::memory_order_release);
+        }
+
+        return (int) (end - start);
     }
 
+    // Message thread only. The most commands that have been waiting at once.
+    int getHighWaterMark () const noexcept { return highWaterMark; }
+
+    // Message thread only. The number of commands that didn't fit.
+    int getNumDropped () const noexcept { return numDropped; }
+
 private:
-    template <typename Func>
-    static std::unique_ptr<Command<Proc>> makeCommand (Func&& func)
+    struct Slot
+    {
+        alignas (std::max_align_t) char storage[inlineSize];
+        Command<Proc>* command = nullptr;
+    };
+
+    void timerCallback () override { reclaim (); }
+
+    // Destroys the commands that the audio thread has finished with.
+    void reclaim ()
     {
-        using Decayed = std::decay_t<Func>;
-        return std::make_unique<TemplateCommand<Proc, Decayed>> (std::forward<Func> (func));
+        const auto end = readIndex.load (std::memory_order_acquire);
+
+        for (; reclaimIndex != end; ++reclaimIndex)
+        {
+            auto& slot = slots[(size_t) (reclaimIndex & mask)];
+            std::destroy_at (slot.command);
+            slot.command = nullptr;
+        }
     }
 
-    std::vector<std::unique_ptr<Command<Proc>>> buffer;
-    AbstractFifo abstractFifo;
+    bool isFull () const noexcept
+    {
+        return writeIndex - reclaimIndex == (uint32) slots.size ();
+    }
+
+    void waitForSpace ()
+    {
+        const auto deadline = Time::getMillisecondCounter () + 1000;
+
+        while (isFull () && Time::getMillisecondCounter () < deadline)
+        {
+            Thread::sleep (1);
+            reclaim ();
+        }
+    }
+
+    std::vector<Slot> slots;
+    const uint32 mask;
+
+    // writeIndex and reclaimIndex belong to the producer. The consumer learns
+    // about new commands through writtenIndex, and the producer learns about
+    // finished ones through readIndex.
+    uint32 writeIndex = 0;
+    uint32 reclaimIndex = 0;
+    std::atomic<uint32> writtenIndex { 0 };
+    std::atomic<uint32> readIndex { 0 };
+
+    int highWaterMark = 0;
+    int numDropped = 0;
 };
@@ -20,6 +20,71 @@ inline std::unique_ptr<AudioFormatReader> makeAudioFormatReader (AudioFormatMana
     return std::unique_ptr<AudioFormatReader> (manager.createReaderFor (file));
 }
 
+// Returns a reader which decodes frames straight out of a memory-mapped view of the
+// file, or nullptr if the file's format can't be mapped. Only uncompressed formats,
+// such as WAV and AIFF, support this.
+inline std::unique_ptr<AudioFormatReader> makeMemoryMappedAudioFormatReader (AudioFormatManager& manager,
+                                                                             const File& file)
+{
+    auto* format = manager.findFormatForFileExtension (file.getFileExtension ());
+
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader (format->createMemoryMappedReader (file));
+
+    if (reader == nullptr || ! reader->mapEntireFile ())
+        return nullptr;
+
+    return reader;
+}
+
+// Files are identified by their path, size and modification time, which is
+// much cheaper than hashing their contents, and changes if the file is edited.
+inline String getFileIdentity (const File& file)
+{
+    return "file:" + file.getFullPathName ()
+         + ":" + String (file.getSize ())
+         + ":" + String (file.getLastModificationTime ().toMilliseconds ());
+}
+
+// A 64-bit FNV-1a hash, used to identify in-memory sample data by its contents.
+inline uint64 hashBytes (const void* data, size_t size, uint64 hash = (uint64) 0xcbf29ce484222325)
+{
+    const auto* bytes = static_cast<const uint8*> (data);
+
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * (uint64) 0x100000001b3;
+
+    return hash;
+}
+
+// A hash of the file's size and of the bytes at either end of it. That's enough
+// to tell whether a saved reference still points at the same audio, without
+// having to read the whole of a long file. Returns 0 if the file can't be read.
+inline uint64 getFileFingerprint (const File& file)
+{
+    FileInputStream stream (file);
+
+    if (! stream.openedOk ())
+        return 0;
+
+    constexpr int64 chunkSize = 65536;
+    const auto size = stream.getTotalLength ();
+    HeapBlock<char> buffer ((size_t) chunkSize);
+
+    auto hash = hashBytes (&size, sizeof (size));
+
+    for (auto start : { (int64) 0, jmax ((int64) 0, size - chunkSize) })
+    {
+        stream.setPosition (start);
+        const auto numRead = stream.read (buffer.get (), (int) jmin (chunkSize, size));
+        hash = hashBytes (buffer.get (), (size_t) jmax (0, numRead), hash);
+    }
+
+    return hash;
+}
+
 //==============================================================================
 
 class AudioFormatReaderFactory
@@ -35,6 +100,14 @@ public:
 
     virtual std::unique_ptr<AudioFormatReader> make (AudioFormatManager&) const = 0;
     virtual std::unique_ptr<AudioFormatReaderFactory> clone () const = 0;
+
+    // Returns a string which is the same for any two factories that produce the
+    // same audio, so that samples can be shared between them. An empty string
+    // means that samples from this factory must never be shared.
+    virtual String getIdentity () const { return {}; }
+
+    // The file the audio comes from, if there is one.
+    virtual File getFile () const { return {}; }
 };
 
 //==============================================================================
@@ -44,7 +117,8 @@ class MemoryAudioFormatReaderFactory final : public AudioFormatReaderFactory
 public:
     MemoryAudioFormatReaderFactory (const void* sampleDataIn, size_t dataSizeIn)
         : sampleData (sampleDataIn),
-        dataSize (dataSizeIn)
+        dataSize (dataSizeIn),
+        contentHash (hashBytes (sampleDataIn, dataSizeIn))
     {
     }
 
@@ -58,9 +132,15 @@ public:
         return std::unique_ptr<AudioFormatReaderFactory> (new MemoryAudioFormatReaderFactory (*this));
     }
 
+    String getIdentity () const override
+    {
+        return "memory:" + String::toHexString ((int64) contentHash) + ":" + String ((int64) dataSize);
+    }
+
 private:
     const void* sampleData;
     size_t dataSize;
+    uint64 contentHash;
 };
 
 //==============================================================================
@@ -83,6 +163,99 @@ public:
         return std::unique_ptr<AudioFormatReaderFactory> (new FileAudioFormatReaderFactory (*this));
     }
 
+    String getIdentity () const override
+    {
+        return getFileIdentity (file);
+    }
+
+    File getFile () const override
+    {
+        return file;
+    }
+
+private:
+    File file;
+};
+
+//==============================================================================
+
+// Like MemoryAudioFormatReaderFactory, but keeps its own (shared) copy of the
+// data, such as a sample that was embedded in the plugin's saved state.
+class SharedMemoryAudioFormatReaderFactory final : public AudioFormatReaderFactory
+{
+public:
+    explicit SharedMemoryAudioFormatReaderFactory (std::shared_ptr<const MemoryBlock> dataIn)
+        : data (std::move (dataIn)),
+        contentHash (hashBytes (data->getData (), data->getSize ()))
+    {
+    }
+
+    std::unique_ptr<AudioFormatReader> make (AudioFormatManager& manager) const override
+    {
+        return makeAudioFormatReader (manager, data->getData (), data->getSize ());
+    }
+
+    std::unique_ptr<AudioFormatReaderFactory> clone () const override
+    {
+        return std::unique_ptr<AudioFormatReaderFactory> (new SharedMemoryAudioFormatReaderFactory (*this));
+    }
+
+    // The same as a MemoryAudioFormatReaderFactory with the same contents.
+    String getIdentity () const override
+    {
+        return "memory:" + String::toHexString ((int64) contentHash) + ":" + String ((int64) data->getSize ());
+    }
+
+    const MemoryBlock& getData () const
+    {
+        return *data;
+    }
+
+private:
+    std::shared_ptr<const MemoryBlock> data;
+    uint64 contentHash;
+};
+
+//==============================================================================
+
+// Maps uncompressed files into memory instead of reading them through a stream,
+// so the file is never read into an intermediate buffer, and its pages are
+// shared with the OS file cache (and so with any other plugin instance using the
+// same file). This isn't zero-copy playback: the voices play float data, so the
+// frames are still converted when the sample is loaded, or by the streamer a
+// chunk at a time. That also keeps page faults off the audio thread. Files that
+// can't be mapped are opened in the usual way.
+class MemoryMappedAudioFormatReaderFactory final : public AudioFormatReaderFactory
+{
+public:
+    explicit MemoryMappedAudioFormatReaderFactory (File fileIn)
+        : file (std::move (fileIn))
+    {
+    }
+
+    std::unique_ptr<AudioFormatReader> make (AudioFormatManager& manager) const override
+    {
+        if (auto reader = makeMemoryMappedAudioFormatReader (manager, file))
+            return reader;
+
+        return makeAudioFormatReader (manager, file);
+    }
+
+    std::unique_ptr<AudioFormatReaderFactory> clone () const override
+    {
+        return std::unique_ptr<AudioFormatReaderFactory> (new MemoryMappedAudioFormatReaderFactory (*this));
+    }
+
+    String getIdentity () const override
+    {
+        return getFileIdentity (file);
+    }
+
+    File getFile () const override
+    {
+        return file;
+    }
+
 private:
     File file;
 };
@@ -0,0 +1,69 @@
+#include "Interpolation.h"
+
+PolyphaseSincTable::PolyphaseSincTable (int numTapsIn)
+    : numTaps (numTapsIn),
+    coefficients ((size_t) ((numPhases + 1) * numTapsIn))
+{
+    jassert (numTaps % 4 == 0 && numTaps <= maxInterpolationTaps);
+
+    // Pull the cutoff in slightly below Nyquist, so that the transition band of
+    // the shorter kernels doesn't fold back into the audible range.
+    const auto cutoff = numTaps >= 16 ? 0.95 : 0.9;
+    const auto halfWidth = numTaps / 2;
+
+    for (auto phase = 0; phase <= numPhases; ++phase)
+    {
+        const auto fraction = (double) phase / numPhases;
+        auto* row = coefficients.data () + (size_t) (phase * numTaps);
+        auto sum = 0.0;
+
+        for (auto tap = 0; tap < numTaps; ++tap)
+        {
+            // Distance from this tap's source frame to the point being interpolated.
+            const auto x = (double) (tap - halfWidth + 1) - fraction;
+            const auto sinc = approximatelyEqual (x, 0.0) ? 1.0
+                                                          : std::sin (MathConstants<double>::pi * cutoff * x)
+                                                                / (MathConstants<double>::pi * cutoff * x);
+
+            // Blackman window, centred on the interpolation point.
+            const auto w = MathConstants<double>::twoPi * x / (2 * halfWidth);
+            const auto window = jmax (0.0, 0.42 + 0.5 * std::cos (w) + 0.08 * std::cos (2.0 * w));
+
+            row[tap] = (float) (sinc * window);
+            sum += sinc * window;
+        }
+
+        // Normalise every phase to unity gain at DC, so that a constant signal
+        // doesn't pick up ripple as the fractional position moves.
+        for (auto tap = 0; tap < numTaps; ++tap)
+            row[tap] = (float) (row[tap] / sum);
+    }
+}
+
+//==============================================================================
+
+void SincTables::prepare ()
+{
+    if (isPrepared ())
+        return;
+
+    for (auto mode : { InterpolationMode::sinc8, InterpolationMode::sinc16, InterpolationMode::sinc32 })
+        tables.push_back (std::make_unique<PolyphaseSincTable> (getNumTaps (mode)));
+}
+
+const PolyphaseSincTable* SincTables::getTable (InterpolationMode mode) const
+{
+    if (! isPrepared ())
+        return nullptr;
+
+    switch (mode)
+    {
+        case InterpolationMode::sinc8:  return tables[0].get ();
+        case InterpolationMode::sinc16: return tables[1].get ();
+        case InterpolationMode::sinc32: return tables[2].get ();
+        case InterpolationMode::linear:
+        case InterpolationMode::cubic:  break;
+    }
+
+    return nullptr;
+}
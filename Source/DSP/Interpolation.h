@@ -0,0 +1,86 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+//==============================================================================
+// The interpolation algorithms a voice can use when reading from its sample.
+// Higher quality modes alias less when the sample is pitched far away from its
+// centre frequency, at the cost of reading more source frames per output sample.
+enum class InterpolationMode
+{
+    linear = 0,
+    cubic,
+    sinc8,
+    sinc16,
+    sinc32
+};
+
+inline int getNumTaps (InterpolationMode mode)
+{
+    switch (mode)
+    {
+        case InterpolationMode::linear: return 2;
+        case InterpolationMode::cubic:  return 4;
+        case InterpolationMode::sinc8:  return 8;
+        case InterpolationMode::sinc16: return 16;
+        case InterpolationMode::sinc32: return 32;
+    }
+
+    jassertfalse;
+    return 2;
+}
+
+inline StringArray getInterpolationModeNames ()
+{
+    return { "Linear", "Cubic Hermite", "Sinc (8 taps)", "Sinc (16 taps)", "Sinc (32 taps)" };
+}
+
+// The widest kernel we support. Samples are padded by half of this on either side
+// so that interpolators never need to bounds-check their reads.
+constexpr int maxInterpolationTaps = 32;
+
+//==============================================================================
+// A windowed-sinc filter, sampled at numPhases fractional offsets between two
+// source frames. Row p holds the taps for a fractional position of p / numPhases,
+// and an extra row is stored at the end so that the renderer can always blend
+// between row p and row p + 1.
+class PolyphaseSincTable final
+{
+public:
+    enum { numPhases = 256 };
+
+    explicit PolyphaseSincTable (int numTapsIn);
+
+    int getNumTaps () const { return numTaps; }
+
+    const float* getPhase (int phase) const
+    {
+        jassert (isPositiveAndNotGreaterThan (phase, (int) numPhases));
+        return coefficients.data () + (size_t) (phase * numTaps);
+    }
+
+private:
+    int numTaps;
+    std::vector<float> coefficients;
+};
+
+//==============================================================================
+// Owns one polyphase table for each of the sinc interpolation modes.
+// The tables don't depend on the sample rate, so they only get built the first
+// time prepare() is called. After that they're immutable and can be read from
+// any thread.
+class SincTables final
+{
+public:
+    void prepare ();
+
+    bool isPrepared () const { return ! tables.empty (); }
+
+    // Returns nullptr for modes that don't need a table, or if prepare()
+    // hasn't been called yet.
+    const PolyphaseSincTable* getTable (InterpolationMode mode) const;
+
+private:
+    std::vector<std::unique_ptr<PolyphaseSincTable>> tables;
+};
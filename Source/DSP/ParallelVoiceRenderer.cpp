@@ -0,0 +1,167 @@
+#include "ParallelVoiceRenderer.h"
+#include "../Trace.h"
+
+ParallelVoiceRenderer::ParallelVoiceRenderer ()
+{
+    for (auto i = 0; i < (int) maxThreads; ++i)
+        workers[(size_t) i] = std::make_unique<Worker> (*this, i);
+}
+
+ParallelVoiceRenderer::~ParallelVoiceRenderer ()
+{
+    setNumThreads (0);
+}
+
+void ParallelVoiceRenderer::setNumThreads (int numThreads)
+{
+    numThreads = jlimit (0, (int) maxThreads, numThreads);
+
+    // The audio thread reads this once per block, so from here on it won't hand
+    // out any new work to the workers we're about to stop. Any voices already
+    // assigned to them will be stolen by the remaining participants.
+    numEnabledWorkers.store (numThreads);
+
+    for (auto i = 0; i < (int) maxThreads; ++i)
+    {
+        auto& worker = *workers[(size_t) i];
+
+        if (i < numThreads)
+        {
+            if (! worker.isThreadRunning ())
+                worker.startRealtimeThread (Thread::RealtimeOptions {}.withPriority (10));
+        }
+        else
+        {
+            worker.signalThreadShouldExit ();
+            worker.wake ();
+            worker.stopThread (1000);
+        }
+    }
+}
+
+void ParallelVoiceRenderer::prepare (int maximumBlockSize, int numChannels)
+{
+    numChannels = jlimit (1, 2, numChannels);
+
+    for (auto& worker : workers)
+    {
+        worker->floatScratch.setSize (numChannels, maximumBlockSize);
+        worker->doubleScratch.setSize (numChannels, maximumBlockSize);
+    }
+}
+
+bool ParallelVoiceRenderer::tryJoin (uint32 block)
+{
+    auto current = state.load (std::memory_order_acquire);
+
+    while (getBlock (current) == block && (current & closedFlag) == 0)
+        if (state.compare_exchange_weak (current, current + 1, std::memory_order_acq_rel))
+            return true;
+
+    return false;
+}
+
+void ParallelVoiceRenderer::leave ()
+{
+    state.fetch_sub (1, std::memory_order_release);
+}
+
+int ParallelVoiceRenderer::claimVoice (int participant)
+{
+    if (participant < numParticipants)
+    {
+        auto& own = ranges[(size_t) participant];
+        const auto index = own.next.fetch_add (1, std::memory_order_relaxed);
+
+        if (index < own.end)
+            return index;
+    }
+
+    // Our own range is empty, so try to steal from everyone else, starting
+    // with our neighbour so that thieves don't all pile on to the same range.
+    for (auto offset = 1; offset < numParticipants; ++offset)
+    {
+        auto& victim = ranges[(size_t) ((participant + offset) % numParticipants)];
+
+        if (victim.next.load (std::memory_order_relaxed) >= victim.end)
+            continue;
+
+        const auto index = victim.next.fetch_add (1, std::memory_order_relaxed);
+
+        if (index < victim.end)
+            return index;
+    }
+
+    return -1;
+}
+
+void ParallelVoiceRenderer::runWorker (Worker& worker)
+{
+    SAMPLER_TRACE_THREAD ("Render worker");
+
+    auto lastBlock = publishedBlock.load (std::memory_order_acquire);
+    auto idleIterations = 0;
+
+    while (! worker.threadShouldExit ())
+    {
+        const auto block = publishedBlock.load (std::memory_order_acquire);
+
+        if (block == lastBlock)
+        {
+            // A short spin catches a block that's published just after we finished
+            // the last one, without a system call on either side. Blocks are
+            // normally milliseconds apart, so after that, sleep until we're woken.
+            if (++idleIterations < 1000)
+            {
+                pauseCpu ();
+            }
+            else
+            {
+                waitForBlock (worker, lastBlock);
+                idleIterations = 0;
+            }
+
+            continue;
+        }
+
+        lastBlock = block;
+        idleIterations = 0;
+
+        if (! tryJoin (block))
+            continue;
+
+        // Workers beyond the number of participants for this block may still
+        // have joined, but the audio thread won't collect their output.
+        if (worker.index + 1 < numParticipants)
+        {
+            // The audio thread is waiting on this, so it's held to the same rules.
+            const RealtimeDebug::AudioThreadScope audioThreadScope;
+            SAMPLER_TRACE_SCOPE ("render voices");
+
+            if (doublePrecision)
+                renderOnWorker<double> (worker);
+            else
+                renderOnWorker<float> (worker);
+        }
+
+        leave ();
+    }
+}
+
+void ParallelVoiceRenderer::waitForBlock (Worker& worker, uint32 lastBlock)
+{
+    // This pairs with render(), which publishes the block and then checks
+    // whether we're asleep. Either it sees the flag, or we see the block.
+    worker.sleeping.store (true);
+
+    if (publishedBlock.load () == lastBlock && ! worker.threadShouldExit ())
+    {
+        worker.wakeUp.wait ();
+        return;
+    }
+
+    // There's no need to sleep after all. If someone cleared the flag first,
+    // they've signalled, so take that signal now rather than waking up to it later.
+    if (! worker.sleeping.exchange (false))
+        worker.wakeUp.wait ();
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "SamplerVoiceBank.h"
+#include "../Semaphore.h"
+
+//==============================================================================
+// Spreads the active voices of a SamplerVoiceBank across a small pool of
+// realtime worker threads.
+//
+// Each block, the active voices are divided into one contiguous range per
+// participant (the audio thread counts as participant 0). Every participant
+// works through its own range by bumping an atomic cursor, and once that's
+// exhausted it steals voices from the other ranges in the same way. That means
+// a worker which wakes up late (or not at all) never holds up the block: the
+// audio thread simply ends up rendering its voices instead.
+//
+// Workers mix into their own scratch buffers, which the audio thread adds into
+// the output once every worker that joined the block has finished. Nothing on
+// the audio thread allocates or takes a lock. Between blocks, a worker spins
+// for a moment, and then sleeps on a semaphore. The audio thread only signals
+// the workers that are asleep, so waking one costs at most a single system call.
+class ParallelVoiceRenderer final
+{
+public:
+    enum { maxThreads = 16 };
+
+    ParallelVoiceRenderer ();
+    ~ParallelVoiceRenderer ();
+
+    // Sets the number of worker threads, not counting the audio thread.
+    // Zero disables parallel rendering. Call this from the message thread;
+    // it's safe to do so while audio is running.
+    void setNumThreads (int numThreads);
+    int getNumThreads () const { return numEnabledWorkers.load (); }
+
+    // Below this many active voices, it's cheaper to render everything on the
+    // audio thread than to hand work out to other threads.
+    void setMinimumVoicesPerThread (int minimum) { minimumVoicesPerThread = jmax (1, minimum); }
+
+    // Allocates the workers' scratch buffers. Must be called before rendering,
+    // while audio is stopped.
+    void prepare (int maximumBlockSize, int numChannels);
+
+    // Adds all of the bank's active voices into the buffer, using the worker
+    // threads. Returns false without doing anything if there are too few
+    // voices, or no workers, in which case the caller should render the bank
+    // itself. When this returns true, the caller should call
+    // releaseFinishedVoices() on the bank.
+    template <typename Element>
+    bool render (SamplerVoiceBank& bank, AudioBuffer<Element>& outputBuffer, int startSample, int numSamples);
+
+private:
+    class Worker;
+
+    // A participant's share of the active voices. 'next' is shared with any
+    // thread that steals from this range.
+    struct alignas (64) Range
+    {
+        std::atomic<int> next { 0 };
+        int end = 0;
+    };
+
+    // The current block, and the number of workers rendering it, packed into a
+    // single atomic so that a worker can only join the block it saw published.
+    // Bit 31 marks the block as closed to new workers.
+    static constexpr uint64 closedFlag = (uint64) 1 << 31;
+    static constexpr uint64 countMask = closedFlag - 1;
+
+    static uint64 makeState (uint32 block) { return (uint64) block << 32; }
+    static uint32 getBlock (uint64 state) { return (uint32) (state >> 32); }
+
+    bool tryJoin (uint32 block);
+    void leave ();
+
+    // Claims the next voice index for the given participant, stealing from the
+    // other participants' ranges when its own is empty. Returns -1 when every
+    // range is exhausted.
+    int claimVoice (int participant);
+
+    template <typename Element>
+    void renderOnWorker (Worker& worker);
+
+    void runWorker (Worker& worker);
+
+    // Tells the CPU we're in a spin-wait loop, so that it can save power and give
+    // the other hyperthread a chance.
+    static void pauseCpu () noexcept
+    {
+       #if SAMPLER_USE_SSE
+        _mm_pause ();
+       #elif JUCE_ARM && (defined (__aarch64__) || defined (__ARM_ARCH_7A__)) && ! JUCE_MSVC
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    // Sleeps until the audio thread publishes a block after 'lastBlock', or the
+    // worker is asked to stop.
+    void waitForBlock (Worker& worker, uint32 lastBlock);
+
+    // These describe the block currently being rendered. They're written by the
+    // audio thread before the block counter is published, and read by workers
+    // after they've joined.
+    SamplerVoiceBank* bank = nullptr;
+    int numSamples = 0;
+    int numOutputChannels = 0;
+    bool doublePrecision = false;
+    int numParticipants = 0;
+    std::array<Range, maxThreads + 1> ranges;
+
+    std::atomic<uint64> state { 0 };
+    std::atomic<uint32> publishedBlock { 0 };
+    std::atomic<int> numEnabledWorkers { 0 };
+    int minimumVoicesPerThread = 8;
+
+    std::array<std::unique_ptr<Worker>, maxThreads> workers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParallelVoiceRenderer)
+};
+
+//==============================================================================
+class ParallelVoiceRenderer::Worker final : public Thread
+{
+public:
+    Worker (ParallelVoiceRenderer& ownerIn, int indexIn)
+        : Thread ("Sampler voice worker " + String (indexIn)),
+        owner (ownerIn),
+        index (indexIn)
+    {
+    }
+
+    void run () override { owner.runWorker (*this); }
+
+    // Any thread. Wakes the worker if it's asleep.
+    void wake () noexcept
+    {
+        if (sleeping.load () && sleeping.exchange (false))
+            wakeUp.signal ();
+    }
+
+    template <typename Element>
+    AudioBuffer<Element>& getScratch ();
+
+    ParallelVoiceRenderer& owner;
+    const int index;
+
+    AudioBuffer<float> floatScratch;
+    AudioBuffer<double> doubleScratch;
+
+    // Set by the worker if it rendered anything into its scratch buffer during
+    // the current block. Only read by the audio thread after the worker has left.
+    bool contributed = false;
+
+    // Set by the worker before it sleeps. Whoever clears it has to signal.
+    std::atomic<bool> sleeping { false };
+    Semaphore wakeUp;
+};
+
+template <>
+inline AudioBuffer<float>& ParallelVoiceRenderer::Worker::getScratch<float> () { return floatScratch; }
+
+template <>
+inline AudioBuffer<double>& ParallelVoiceRenderer::Worker::getScratch<double> () { return doubleScratch; }
+
+//==============================================================================
+
+template<typename Element>
+bool ParallelVoiceRenderer::render (SamplerVoiceBank& bankIn,
+                                    AudioBuffer<Element>& outputBuffer,
+                                    int startSample,
+                                    int numSamplesIn)
+{
+    const auto numVoices = bankIn.getNumActiveVoices ();
+    const auto numWorkers = jmin (numEnabledWorkers.load (std::memory_order_relaxed),
+                                  numVoices / minimumVoicesPerThread - 1);
+
+    if (numWorkers <= 0 || numSamplesIn > workers[0]->getScratch<Element> ().getNumSamples ())
+        return false;
+
+    bank = &bankIn;
+    numSamples = numSamplesIn;
+    numOutputChannels = jmin (outputBuffer.getNumChannels (), 2);
+    doublePrecision = std::is_same_v<Element, double>;
+    numParticipants = numWorkers + 1;
+
+    for (auto p = 0; p < numParticipants; ++p)
+    {
+        ranges[(size_t) p].next.store (numVoices * p / numParticipants, std::memory_order_relaxed);
+        ranges[(size_t) p].end = numVoices * (p + 1) / numParticipants;
+    }
+
+    for (auto i = 0; i < numWorkers; ++i)
+        workers[(size_t) i]->contributed = false;
+
+    // Publishing the new block makes everything above visible to the workers.
+    // It has to be ordered before we check which of them are asleep, or one
+    // could miss the block and not be woken.
+    const auto block = publishedBlock.load (std::memory_order_relaxed) + 1;
+    state.store (makeState (block), std::memory_order_release);
+    publishedBlock.store (block);
+
+    for (auto i = 0; i < numWorkers; ++i)
+        workers[(size_t) i]->wake ();
+
+    // The audio thread renders straight into the output.
+    for (auto voice = claimVoice (0); voice >= 0; voice = claimVoice (0))
+        bankIn.renderVoice (bankIn.getActiveSlot (voice), outputBuffer, startSample, numSamples);
+
+    // All voices have been claimed, so stop any more workers from joining, and
+    // wait for the ones that did to finish the voices they're rendering.
+    state.fetch_or (closedFlag, std::memory_order_acq_rel);
+
+    while ((state.load (std::memory_order_acquire) & countMask) != 0)
+        pauseCpu ();
+
+    for (auto i = 0; i < numWorkers; ++i)
+    {
+        auto& worker = *workers[(size_t) i];
+
+        if (! worker.contributed)
+            continue;
+
+        auto& scratch = worker.getScratch<Element> ();
+
+        for (auto channel = 0; channel < numOutputChannels; ++channel)
+            outputBuffer.addFrom (channel, startSample, scratch, channel, 0, numSamples);
+    }
+
+    return true;
+}
+
+template<typename Element>
+void ParallelVoiceRenderer::renderOnWorker (Worker& worker)
+{
+    auto& scratch = worker.getScratch<Element> ();
+
+    // Refer to just the channels and samples of this block, without allocating.
+    AudioBuffer<Element> output (scratch.getArrayOfWritePointers (), numOutputChannels, numSamples);
+
+    for (auto voice = claimVoice (worker.index + 1); voice >= 0; voice = claimVoice (worker.index + 1))
+    {
+        if (! worker.contributed)
+        {
+            output.clear ();
+            worker.contributed = true;
+        }
+
+        bank->renderVoice (bank->getActiveSlot (voice), output, 0, numSamples);
+    }
+}
@@ -0,0 +1,130 @@
+#include "PeakPyramid.h"
+#include "RenderKernels.h"
+
+namespace
+{
+// The number of buckets decoded at a time while building level 0.
+constexpr int bucketsPerRead = 256;
+} // namespace
+
+std::shared_ptr<const PeakPyramid> PeakPyramid::build (const OurSample& sample,
+                                                       AudioFormatReader* source,
+                                                       const OurSample::ProgressCallback& progress)
+{
+    std::shared_ptr<PeakPyramid> pyramid (new PeakPyramid ());
+    pyramid->numFrames = sample.getLength ();
+    pyramid->sampleRate = sample.getSampleRate ();
+
+    const auto numChannels = jlimit (1, 2, sample.getNumChannels ());
+    const auto framesPerRead = bucketsPerRead * (int) baseBucketSize;
+
+    // Only needed for the frames that aren't in memory.
+    AudioBuffer<float> buffer;
+
+    if (sample.isStreaming ())
+        buffer.setSize (sample.getNumChannels (), framesPerRead);
+
+    std::vector<Peak> buckets;
+    buckets.reserve ((size_t) ((pyramid->numFrames + baseBucketSize - 1) / baseBucketSize));
+
+    for (int64 start = 0; start < pyramid->numFrames; start += framesPerRead)
+    {
+        if (progress != nullptr && ! progress ((double) start / (double) pyramid->numFrames))
+            return nullptr;
+
+        const auto numToRead = (int) jmin ((int64) framesPerRead, pyramid->numFrames - start);
+        const float* channels[2] {};
+
+        if (start + numToRead <= sample.getNumResidentFrames ())
+        {
+            for (auto channel = 0; channel < numChannels; ++channel)
+                channels[channel] = sample.getReadPointer (channel) + start;
+        }
+        else
+        {
+            if (source != nullptr)
+                source->read (&buffer, 0, numToRead, start, true, true);
+            else
+                sample.readFromSource (buffer, numToRead, start);
+
+            for (auto channel = 0; channel < numChannels; ++channel)
+                channels[channel] = buffer.getReadPointer (channel);
+        }
+
+        for (auto offset = 0; offset < numToRead; offset += baseBucketSize)
+        {
+            const auto length = jmin ((int) baseBucketSize, numToRead - offset);
+            auto min = 0.0f, max = 0.0f, sumOfSquares = 0.0f;
+
+            for (auto channel = 0; channel < numChannels; ++channel)
+            {
+                const auto* data = channels[channel] + offset;
+                const auto range = FloatVectorOperations::findMinAndMax (data, length);
+
+                min = channel == 0 ? range.getStart () : jmin (min, range.getStart ());
+                max = channel == 0 ? range.getEnd () : jmax (max, range.getEnd ());
+                sumOfSquares += RenderKernels::sumOfSquares (data, length);
+            }
+
+            buckets.push_back ({ min, max, sumOfSquares / (float) (length * numChannels) });
+        }
+    }
+
+    pyramid->levels.push_back (std::move (buckets));
+
+    while (pyramid->levels.back ().size () > 1)
+    {
+        const auto& below = pyramid->levels.back ();
+        std::vector<Peak> level;
+        level.reserve ((below.size () + 1) / 2);
+
+        for (size_t i = 0; i < below.size (); i += 2)
+            level.push_back (i + 1 < below.size () ? combine (below[i], below[i + 1]) : below[i]);
+
+        pyramid->levels.push_back (std::move (level));
+    }
+
+    return pyramid;
+}
+
+PeakPyramid::Peak PeakPyramid::getPeak (int64 startFrame, int64 endFrame) const
+{
+    if (numFrames == 0 || levels.front ().empty ())
+        return {};
+
+    startFrame = jlimit ((int64) 0, numFrames - 1, startFrame);
+    endFrame = jlimit (startFrame + 1, numFrames, endFrame);
+
+    // Pick the coarsest level whose buckets still fit inside the range, so that
+    // it only takes two or three buckets to cover it.
+    size_t level = 0;
+    auto bucketSize = (int64) baseBucketSize;
+
+    while (level + 1 < levels.size () && bucketSize * 2 <= endFrame - startFrame)
+    {
+        ++level;
+        bucketSize *= 2;
+    }
+
+    const auto& buckets = levels[level];
+    const auto first = (size_t) (startFrame / bucketSize);
+    const auto last = jmin (buckets.size () - 1, (size_t) ((endFrame - 1) / bucketSize));
+
+    auto result = buckets[first];
+    auto sumOfMeanSquares = result.meanSquare;
+
+    for (auto i = first + 1; i <= last; ++i)
+    {
+        result.min = jmin (result.min, buckets[i].min);
+        result.max = jmax (result.max, buckets[i].max);
+        sumOfMeanSquares += buckets[i].meanSquare;
+    }
+
+    result.meanSquare = sumOfMeanSquares / (float) (last - first + 1);
+    return result;
+}
+
+PeakPyramid::Peak PeakPyramid::combine (const Peak& a, const Peak& b)
+{
+    return { jmin (a.min, b.min), jmax (a.max, b.max), (a.meanSquare + b.meanSquare) * 0.5f };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Sampler.h"
+
+//==============================================================================
+// A summary of a sample's levels at every power-of-two zoom level, for drawing
+// its waveform.
+//
+// Level 0 holds the minimum, maximum and mean square of every bucket of
+// 'baseBucketSize' frames, with all of the channels folded together. Each level
+// above that combines pairs of buckets from the level below, so the whole
+// pyramid takes up less than twice as much memory as level 0. Summarising any
+// range of frames only ever visits a handful of buckets, however long the range.
+//
+// A pyramid is built once, in the background, after the sample it summarises
+// has started playing, and never changes after that. It's attached to the
+// sample, so every instance and every editor showing the sample uses the same one.
+class PeakPyramid final
+{
+public:
+    enum { baseBucketSize = 128 };
+
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float meanSquare = 0.0f;
+
+        float getRms () const { return std::sqrt (meanSquare); }
+    };
+
+    // Summarises every frame the sample can play. The frames beyond a streaming
+    // sample's head are read from 'source' if there is one, which should be a
+    // separate reader for the same data, so that the streamer isn't held up.
+    // Otherwise they're read through the sample. Returns nullptr if the progress
+    // callback returns false.
+    static std::shared_ptr<const PeakPyramid> build (const OurSample& sample,
+                                                     AudioFormatReader* source,
+                                                     const OurSample::ProgressCallback& progress);
+
+    int64 getNumFrames () const { return numFrames; }
+    double getSampleRate () const { return sampleRate; }
+
+    // Summarises the frames in [startFrame, endFrame). Ranges shorter than a
+    // bucket are given the levels of the bucket(s) they fall in.
+    Peak getPeak (int64 startFrame, int64 endFrame) const;
+
+    // The largest absolute level anywhere in the sample.
+    float getPeakLevel () const
+    {
+        const auto peak = getPeak (0, numFrames);
+        return jmax (peak.max, -peak.min);
+    }
+
+private:
+    PeakPyramid () = default;
+
+    static Peak combine (const Peak& a, const Peak& b);
+
+    // levels[0] has one entry per bucket, and each level after that has half
+    // as many (rounded up) as the one before.
+    std::vector<std::vector<Peak>> levels;
+    int64 numFrames = 0;
+    double sampleRate = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PeakPyramid)
+};
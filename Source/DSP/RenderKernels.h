@@ -0,0 +1,392 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+#include "Interpolation.h"
+
+#if JUCE_INTEL
+ #define SAMPLER_USE_SSE 1
+ #if defined (__AVX__)
+  #define SAMPLER_USE_AVX 1
+ #endif
+ #if defined (__AVX2__)
+  #define SAMPLER_USE_AVX2 1
+ #endif
+ #include <immintrin.h>
+#elif JUCE_ARM && (defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64))
+ #define SAMPLER_USE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+// Inner loops used by the sampler voices.
+//
+// A voice first works out a 'segment': the number of samples it can render
+// before it runs off the end of its sample or finishes tailing off, together
+// with the read position, interpolation fraction and gain of every one of those
+// samples. Once that's done, the functions in here interpolate and mix the whole
+// segment in one go, without any per-sample branching.
+//
+// All of the maths in here happens in single precision. Compared to the old
+// sample-by-sample renderer (which worked in the precision of the output buffer)
+// the results differ by no more than maxErrorFromScalar for full-scale input,
+// which is well below the noise floor of a 16-bit source file. The kernel
+// benchmark checks this on whichever instruction set it was built for.
+namespace RenderKernels
+{
+
+constexpr float maxErrorFromScalar = 1.0e-5f;
+
+// Segments are kept short so that they fit in small buffers on the stack.
+constexpr int maxSegmentLength = 64;
+
+struct Segment
+{
+    alignas (32) int positions[maxSegmentLength];
+    alignas (32) float fractions[maxSegmentLength];
+    alignas (32) float levels[maxSegmentLength];
+    int length = 0;
+};
+
+// Makes the segment render silence, without reading anything outside the first
+// couple of frames of the source.
+inline void makeSilent (Segment& segment) noexcept
+{
+    for (auto i = 0; i < segment.length; ++i)
+    {
+        segment.positions[i] = 0;
+        segment.levels[i] = 0.0f;
+    }
+}
+
+namespace detail
+{
+
+// A minimal wrapper around whichever vector registers we have available, so
+// that each kernel only needs to be written once.
+#if SAMPLER_USE_AVX
+struct Vec
+{
+    using Reg = __m256;
+    static constexpr int width = 8;
+
+    static Reg load (const float* p)            { return _mm256_loadu_ps (p); }
+    static void store (float* p, Reg v)         { _mm256_storeu_ps (p, v); }
+    static Reg broadcast (float v)              { return _mm256_set1_ps (v); }
+    static Reg add (Reg a, Reg b)               { return _mm256_add_ps (a, b); }
+    static Reg sub (Reg a, Reg b)               { return _mm256_sub_ps (a, b); }
+    static Reg mul (Reg a, Reg b)               { return _mm256_mul_ps (a, b); }
+
+    static float sum (Reg v)
+    {
+        auto s = _mm_add_ps (_mm256_castps256_ps128 (v), _mm256_extractf128_ps (v, 1));
+        auto shuffled = _mm_shuffle_ps (s, s, _MM_SHUFFLE (2, 3, 0, 1));
+        s = _mm_add_ps (s, shuffled);
+        shuffled = _mm_movehl_ps (shuffled, s);
+        return _mm_cvtss_f32 (_mm_add_ss (s, shuffled));
+    }
+};
+#elif SAMPLER_USE_SSE
+struct Vec
+{
+    using Reg = __m128;
+    static constexpr int width = 4;
+
+    static Reg load (const float* p)            { return _mm_loadu_ps (p); }
+    static void store (float* p, Reg v)         { _mm_storeu_ps (p, v); }
+    static Reg broadcast (float v)              { return _mm_set1_ps (v); }
+    static Reg add (Reg a, Reg b)               { return _mm_add_ps (a, b); }
+    static Reg sub (Reg a, Reg b)               { return _mm_sub_ps (a, b); }
+    static Reg mul (Reg a, Reg b)               { return _mm_mul_ps (a, b); }
+
+    static float sum (Reg v)
+    {
+        auto shuffled = _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1));
+        auto s = _mm_add_ps (v, shuffled);
+        shuffled = _mm_movehl_ps (shuffled, s);
+        return _mm_cvtss_f32 (_mm_add_ss (s, shuffled));
+    }
+};
+#elif SAMPLER_USE_NEON
+struct Vec
+{
+    using Reg = float32x4_t;
+    static constexpr int width = 4;
+
+    static Reg load (const float* p)            { return vld1q_f32 (p); }
+    static void store (float* p, Reg v)         { vst1q_f32 (p, v); }
+    static Reg broadcast (float v)              { return vdupq_n_f32 (v); }
+    static Reg add (Reg a, Reg b)               { return vaddq_f32 (a, b); }
+    static Reg sub (Reg a, Reg b)               { return vsubq_f32 (a, b); }
+    static Reg mul (Reg a, Reg b)               { return vmulq_f32 (a, b); }
+
+    static float sum (Reg v)
+    {
+       #if defined (__aarch64__) || defined (_M_ARM64)
+        return vaddvq_f32 (v);
+       #else
+        const auto pairs = vadd_f32 (vget_low_f32 (v), vget_high_f32 (v));
+        return vget_lane_f32 (vpadd_f32 (pairs, pairs), 0);
+       #endif
+    }
+};
+#else
+struct Vec
+{
+    using Reg = float;
+    static constexpr int width = 1;
+
+    static Reg load (const float* p)            { return *p; }
+    static void store (float* p, Reg v)         { *p = v; }
+    static Reg broadcast (float v)              { return v; }
+    static Reg add (Reg a, Reg b)               { return a + b; }
+    static Reg sub (Reg a, Reg b)               { return a - b; }
+    static Reg mul (Reg a, Reg b)               { return a * b; }
+
+    static float sum (Reg v)                    { return v; }
+};
+#endif
+
+// Applies 'op' to each vector-sized chunk of [0, num), then to each leftover sample
+// using the scalar fallback.
+template <typename VectorOp, typename ScalarOp>
+inline void forEachChunk (int num, VectorOp&& vectorOp, ScalarOp&& scalarOp)
+{
+    auto i = 0;
+
+    for (; i + Vec::width <= num; i += Vec::width)
+        vectorOp (i);
+
+    for (; i < num; ++i)
+        scalarOp (i);
+}
+
+} // namespace detail
+
+//==============================================================================
+// Linearly interpolates the source at each position in the segment, scales the
+// result by the segment's level ramp, and writes it to dest.
+inline void renderLinear (const float* in, const Segment& segment, float* dest) noexcept
+{
+    using detail::Vec;
+
+    alignas (32) float current[maxSegmentLength];
+    alignas (32) float next[maxSegmentLength];
+
+    const auto num = segment.length;
+    auto i = 0;
+
+   #if SAMPLER_USE_AVX2
+    for (; i + 8 <= num; i += 8)
+    {
+        const auto index = _mm256_load_si256 (reinterpret_cast<const __m256i*> (segment.positions + i));
+        _mm256_store_ps (current + i, _mm256_i32gather_ps (in, index, 4));
+        _mm256_store_ps (next + i, _mm256_i32gather_ps (in + 1, index, 4));
+    }
+   #endif
+
+    for (; i < num; ++i)
+    {
+        current[i] = in[segment.positions[i]];
+        next[i] = in[segment.positions[i] + 1];
+    }
+
+    detail::forEachChunk (num,
+                          [&] (int n)
+                          {
+                              const auto a = Vec::load (current + n);
+                              const auto b = Vec::load (next + n);
+                              const auto interpolated = Vec::add (a, Vec::mul (Vec::load (segment.fractions + n), Vec::sub (b, a)));
+                              Vec::store (dest + n, Vec::mul (interpolated, Vec::load (segment.levels + n)));
+                          },
+                          [&] (int n)
+                          {
+                              const auto a = current[n];
+                              dest[n] = (a + segment.fractions[n] * (next[n] - a)) * segment.levels[n];
+                          });
+}
+
+//==============================================================================
+// Cubic Hermite (Catmull-Rom) interpolation, reading one frame before and two
+// frames after each position.
+inline void renderCubic (const float* in, const Segment& segment, float* dest) noexcept
+{
+    using detail::Vec;
+
+    alignas (32) float previous[maxSegmentLength];
+    alignas (32) float current[maxSegmentLength];
+    alignas (32) float next[maxSegmentLength];
+    alignas (32) float afterNext[maxSegmentLength];
+
+    const auto num = segment.length;
+
+    for (auto i = 0; i < num; ++i)
+    {
+        const auto* frames = in + segment.positions[i];
+        previous[i] = frames[-1];
+        current[i] = frames[0];
+        next[i] = frames[1];
+        afterNext[i] = frames[2];
+    }
+
+    const auto half = Vec::broadcast (0.5f);
+    const auto oneAndAHalf = Vec::broadcast (1.5f);
+    const auto two = Vec::broadcast (2.0f);
+    const auto twoAndAHalf = Vec::broadcast (2.5f);
+
+    detail::forEachChunk (num,
+                          [&] (int n)
+                          {
+                              const auto xm1 = Vec::load (previous + n);
+                              const auto x0 = Vec::load (current + n);
+                              const auto x1 = Vec::load (next + n);
+                              const auto x2 = Vec::load (afterNext + n);
+                              const auto f = Vec::load (segment.fractions + n);
+
+                              const auto c1 = Vec::mul (half, Vec::sub (x1, xm1));
+                              const auto c2 = Vec::sub (Vec::add (Vec::sub (xm1, Vec::mul (twoAndAHalf, x0)), Vec::mul (two, x1)),
+                                                        Vec::mul (half, x2));
+                              const auto c3 = Vec::add (Vec::mul (half, Vec::sub (x2, xm1)),
+                                                        Vec::mul (oneAndAHalf, Vec::sub (x0, x1)));
+
+                              const auto y = Vec::add (Vec::mul (Vec::add (Vec::mul (Vec::add (Vec::mul (c3, f), c2), f), c1), f), x0);
+                              Vec::store (dest + n, Vec::mul (y, Vec::load (segment.levels + n)));
+                          },
+                          [&] (int n)
+                          {
+                              const auto xm1 = previous[n], x0 = current[n], x1 = next[n], x2 = afterNext[n];
+                              const auto f = segment.fractions[n];
+
+                              const auto c1 = 0.5f * (x1 - xm1);
+                              const auto c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+                              const auto c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+                              dest[n] = (((c3 * f + c2) * f + c1) * f + x0) * segment.levels[n];
+                          });
+}
+
+//==============================================================================
+// Windowed-sinc interpolation using a precomputed polyphase table. Each output
+// sample is a dot product between the source frames around the read position and
+// a row of the table, blended linearly between the two nearest phases.
+inline void renderSinc (const float* in, const PolyphaseSincTable& table, const Segment& segment, float* dest) noexcept
+{
+    using detail::Vec;
+
+    const auto numTaps = table.getNumTaps ();
+    const auto firstTap = 1 - numTaps / 2;
+
+    jassert (numTaps % Vec::width == 0);
+
+    for (auto i = 0; i < segment.length; ++i)
+    {
+        const auto scaledPhase = segment.fractions[i] * (float) PolyphaseSincTable::numPhases;
+        const auto phase = jmin ((int) scaledPhase, (int) PolyphaseSincTable::numPhases - 1);
+        const auto blend = Vec::broadcast (scaledPhase - (float) phase);
+
+        const auto* frames = in + segment.positions[i] + firstTap;
+        const auto* lower = table.getPhase (phase);
+        const auto* upper = table.getPhase (phase + 1);
+
+        auto total = Vec::broadcast (0.0f);
+
+        for (auto tap = 0; tap < numTaps; tap += Vec::width)
+        {
+            const auto a = Vec::load (lower + tap);
+            const auto coefficients = Vec::add (a, Vec::mul (blend, Vec::sub (Vec::load (upper + tap), a)));
+            total = Vec::add (total, Vec::mul (Vec::load (frames + tap), coefficients));
+        }
+
+        dest[i] = Vec::sum (total) * segment.levels[i];
+    }
+}
+
+//==============================================================================
+// Renders the segment with whichever interpolator the mode asks for, falling
+// back to linear interpolation if a sinc table isn't available.
+inline void renderInterpolated (InterpolationMode mode,
+                                const SincTables& tables,
+                                const float* in,
+                                const Segment& segment,
+                                float* dest) noexcept
+{
+    if (mode == InterpolationMode::cubic)
+        return renderCubic (in, segment, dest);
+
+    if (auto* table = tables.getTable (mode))
+        return renderSinc (in, *table, segment, dest);
+
+    renderLinear (in, segment, dest);
+}
+
+//==============================================================================
+// dest[i] += src[i]
+inline void accumulate (float* dest, const float* src, int num) noexcept
+{
+    using detail::Vec;
+
+    detail::forEachChunk (num,
+                          [&] (int n) { Vec::store (dest + n, Vec::add (Vec::load (dest + n), Vec::load (src + n))); },
+                          [&] (int n) { dest[n] += src[n]; });
+}
+
+inline void accumulate (double* dest, const float* src, int num) noexcept
+{
+    auto i = 0;
+
+   #if SAMPLER_USE_SSE
+    for (; i + 2 <= num; i += 2)
+    {
+        const auto wide = _mm_cvtps_pd (_mm_castsi128_ps (_mm_loadl_epi64 (reinterpret_cast<const __m128i*> (src + i))));
+        _mm_storeu_pd (dest + i, _mm_add_pd (_mm_loadu_pd (dest + i), wide));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dest[i] += (double) src[i];
+}
+
+// dest[i] += (left[i] + right[i]) * 0.5, used to fold a stereo source down to a mono output.
+inline void accumulateAverage (float* dest, const float* left, const float* right, int num) noexcept
+{
+    using detail::Vec;
+
+    const auto half = Vec::broadcast (0.5f);
+
+    detail::forEachChunk (num,
+                          [&] (int n)
+                          {
+                              const auto mid = Vec::mul (Vec::add (Vec::load (left + n), Vec::load (right + n)), half);
+                              Vec::store (dest + n, Vec::add (Vec::load (dest + n), mid));
+                          },
+                          [&] (int n) { dest[n] += (left[n] + right[n]) * 0.5f; });
+}
+
+inline void accumulateAverage (double* dest, const float* left, const float* right, int num) noexcept
+{
+    for (auto i = 0; i < num; ++i)
+        dest[i] += ((double) left[i] + (double) right[i]) * 0.5;
+}
+
+// Returns the sum of src[i] * src[i]. Not used while rendering, but it's the
+// inner loop of the waveform overview's RMS levels.
+inline float sumOfSquares (const float* src, int num) noexcept
+{
+    using detail::Vec;
+
+    auto vectorSum = Vec::broadcast (0.0f);
+    auto scalarSum = 0.0f;
+
+    detail::forEachChunk (num,
+                          [&] (int n)
+                          {
+                              const auto v = Vec::load (src + n);
+                              vectorSum = Vec::add (vectorSum, Vec::mul (v, v));
+                          },
+                          [&] (int n) { scalarSum += src[n] * src[n]; });
+
+    return Vec::sum (vectorSum) + scalarSum;
+}
+
+} // namespace RenderKernels
@@ -0,0 +1,115 @@
+#include "SampleLoader.h"
+#include "../Trace.h"
+
+SampleLoader::SampleLoader (const char* threadNameIn)
+    : Thread (threadNameIn),
+    threadName (threadNameIn)
+{
+    startThread (Thread::Priority::low);
+}
+
+SampleLoader::~SampleLoader ()
+{
+    cancel ();
+    stopThread (4000);
+}
+
+void SampleLoader::load (Job job)
+{
+    {
+        const ScopedLock sl (lock);
+        pendingJob = std::move (job);
+        pendingGeneration = ++generation;
+    }
+
+    loading = true;
+    progress = 0.0;
+    notify ();
+}
+
+void SampleLoader::cancel ()
+{
+    {
+        const ScopedLock sl (lock);
+        pendingJob = nullptr;
+        completion = nullptr;
+        ++generation;
+    }
+
+    cancelPendingUpdate ();
+    loading = false;
+    progress = -1.0;
+}
+
+void SampleLoader::run ()
+{
+    SAMPLER_TRACE_THREAD (threadName);
+
+    while (! threadShouldExit ())
+    {
+        Job job;
+        uint32 jobGeneration = 0;
+
+        {
+            const ScopedLock sl (lock);
+            std::swap (job, pendingJob);
+            jobGeneration = pendingGeneration;
+        }
+
+        if (job == nullptr)
+        {
+            wait (-1);
+            continue;
+        }
+
+        SAMPLER_TRACE_SCOPE ("SampleLoader job");
+        const auto isCurrent = [this, jobGeneration] { return generation.load () == jobGeneration; };
+
+        auto result = job ([this, &isCurrent] (double fraction)
+                           {
+                               if (! isCurrent () || threadShouldExit ())
+                                   return false;
+
+                               progress = fraction;
+                               return true;
+                           });
+
+        const ScopedLock sl (lock);
+
+        // A newer job will take care of updating the progress.
+        if (! isCurrent ())
+            continue;
+
+        if (result != nullptr)
+        {
+            completion = std::move (result);
+            completionGeneration = jobGeneration;
+            triggerAsyncUpdate ();
+        }
+        else
+        {
+            loading = false;
+            progress = -1.0;
+        }
+    }
+}
+
+void SampleLoader::handleAsyncUpdate ()
+{
+    std::function<void ()> toCall;
+
+    {
+        const ScopedLock sl (lock);
+
+        if (completionGeneration != generation.load ())
+            return;
+
+        std::swap (toCall, completion);
+    }
+
+    loading = false;
+    progress = -1.0;
+
+    if (toCall != nullptr)
+        toCall ();
+}
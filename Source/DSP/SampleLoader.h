@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Sampler.h"
+
+//==============================================================================
+// Runs sample-loading jobs on a background thread, one at a time.
+//
+// Starting a new job cancels the one in flight (if any), so a burst of requests
+// only ever results in the most recent one being delivered. Each request gets a
+// new generation number, and jobs poll the current generation through their
+// progress callback, so a superseded job stops as soon as it next reports its
+// progress.
+//
+// A finished job hands back a function, which is called on the message thread,
+// and only if no other job has been started since.
+class SampleLoader final : private Thread,
+                           private AsyncUpdater
+{
+public:
+    // Called on the loading thread. Returns the function to call on the message
+    // thread once loading has finished, or nullptr if the job failed or noticed
+    // that it had been cancelled.
+    using Job = std::function<std::function<void ()> (const OurSample::ProgressCallback&)>;
+
+    // The name is used for the thread and its trace events, so it must be a
+    // string literal.
+    explicit SampleLoader (const char* threadName = "Sample loader");
+    ~SampleLoader () override;
+
+    // These must only be called from the message thread.
+    void load (Job job);
+    void cancel ();
+
+    bool isLoading () const { return loading.load (); }
+
+    // Between 0 and 1, or -1 when nothing is loading.
+    double getProgress () const { return progress.load (); }
+
+private:
+    void run () override;
+    void handleAsyncUpdate () override;
+
+    const char* const threadName;
+
+    std::atomic<uint32> generation { 0 };
+    std::atomic<bool> loading { false };
+    std::atomic<double> progress { -1.0 };
+
+    CriticalSection lock;
+    Job pendingJob;
+    uint32 pendingGeneration = 0;
+    std::function<void ()> completion;
+    uint32 completionGeneration = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleLoader)
+};
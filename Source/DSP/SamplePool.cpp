@@ -0,0 +1,132 @@
+#include "SamplePool.h"
+
+std::shared_ptr<const OurSample> SamplePool::getOrLoad (const String& key,
+                                                        const std::function<std::shared_ptr<const OurSample> ()>& load)
+{
+    if (key.isEmpty ())
+        return load ();
+
+    // Samples leaving the cache may be the last reference to them, and there's
+    // no need to free all that memory with the lock held. Declaring this
+    // before the locks means it's released after them.
+    std::vector<std::shared_ptr<const OurSample>> evicted;
+
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+
+        if (auto existing = samples[key].lock ())
+        {
+            ++hits;
+            evicted = touch (key, existing);
+            return existing;
+        }
+
+        ++misses;
+    }
+
+    // Decoding may take a while, so don't hold up other instances meanwhile.
+    auto loaded = load ();
+
+    if (loaded == nullptr)
+        return nullptr;
+
+    const std::lock_guard<std::mutex> lock (mutex);
+    removeExpiredSamples ();
+
+    auto& entry = samples[key];
+
+    // Someone else got there first, so use their copy and throw ours away.
+    if (auto existing = entry.lock ())
+        loaded = std::move (existing);
+    else
+        entry = loaded;
+
+    evicted = touch (key, loaded);
+    return loaded;
+}
+
+void SamplePool::setCacheBudget (int64 bytes)
+{
+    std::vector<std::shared_ptr<const OurSample>> evicted;
+
+    const std::lock_guard<std::mutex> lock (mutex);
+    cacheBudget = jmax ((int64) 0, bytes);
+    evicted = trimCache ();
+}
+
+int64 SamplePool::getCacheBudget ()
+{
+    const std::lock_guard<std::mutex> lock (mutex);
+    return cacheBudget;
+}
+
+SamplePool::Statistics SamplePool::getStatistics ()
+{
+    const std::lock_guard<std::mutex> lock (mutex);
+    removeExpiredSamples ();
+
+    Statistics stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.numCachedSamples = (int) cache.size ();
+    stats.cachedBytes = cachedBytes;
+
+    for (const auto& entry : samples)
+    {
+        if (auto sample = entry.second.lock ())
+        {
+            ++stats.numSamples;
+            stats.memoryUsageBytes += sample->getMemoryUsageBytes ();
+        }
+    }
+
+    return stats;
+}
+
+std::vector<std::shared_ptr<const OurSample>> SamplePool::touch (const String& key, std::shared_ptr<const OurSample> sample)
+{
+    // A streaming sample holds its source open, and re-reading its head is
+    // cheap, so it isn't worth keeping one alive once nobody's using it.
+    if (cacheBudget == 0 || sample->isStreaming ())
+        return {};
+
+    const auto existing = std::find_if (cache.begin (), cache.end (), [&key] (const CacheEntry& e) { return e.first == key; });
+
+    if (existing != cache.end ())
+    {
+        cache.splice (cache.begin (), cache, existing);
+        return {};
+    }
+
+    cachedBytes += sample->getMemoryUsageBytes ();
+    cache.emplace_front (key, std::move (sample));
+    return trimCache ();
+}
+
+std::vector<std::shared_ptr<const OurSample>> SamplePool::trimCache ()
+{
+    std::vector<std::shared_ptr<const OurSample>> evicted;
+
+    // The most recent sample stays, unless the cache is disabled altogether.
+    const auto minimumSize = cacheBudget > 0 ? (size_t) 1 : (size_t) 0;
+
+    while (cache.size () > minimumSize && cachedBytes > cacheBudget)
+    {
+        cachedBytes -= cache.back ().second->getMemoryUsageBytes ();
+        evicted.push_back (std::move (cache.back ().second));
+        cache.pop_back ();
+    }
+
+    return evicted;
+}
+
+void SamplePool::removeExpiredSamples ()
+{
+    for (auto it = samples.begin (); it != samples.end ();)
+    {
+        if (it->second.expired ())
+            it = samples.erase (it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+
+#include "Sampler.h"
+
+//==============================================================================
+// A process-wide pool of decoded samples, so that plugin instances which load
+// the same source share a single copy of its audio.
+//
+// A sample lives for as long as some instance is using it. On top of that, the
+// most recently used samples are kept alive up to a memory budget, so that
+// going back to a sample that was loaded a moment ago (by undoing a change,
+// say) doesn't mean decoding it again. Samples are immutable once they've been
+// loaded, so sharing them between instances (and their audio threads) needs no
+// further synchronisation.
+//
+// Each processor holds the pool through a SharedResourcePointer, so the pool,
+// and everything its cache is keeping alive, goes away with the last instance.
+//
+// Every method takes the pool's lock, so any thread but an audio thread may
+// call them. getOrLoad is called on each instance's loading thread; the rest
+// are for the message thread. Loading happens with the lock released, so two
+// instances racing to load the same source may both decode it, but only the
+// first result is kept.
+class SamplePool final
+{
+public:
+    struct Statistics
+    {
+        int numSamples = 0;
+        int64 memoryUsageBytes = 0;
+        int64 hits = 0;
+        int64 misses = 0;
+
+        // The samples kept alive by the cache, whether or not they're in use.
+        int numCachedSamples = 0;
+        int64 cachedBytes = 0;
+    };
+
+    enum : int64 { defaultCacheBudgetBytes = 256 * 1024 * 1024 };
+
+    SamplePool () = default;
+
+    // Returns the sample stored under the key, or calls load() and stores the
+    // result. An empty key always calls load(), and never stores the result.
+    std::shared_ptr<const OurSample> getOrLoad (const String& key,
+                                                const std::function<std::shared_ptr<const OurSample> ()>& load);
+
+    // Sets how much memory the recently used samples may take up. The cache
+    // always keeps at least the most recent sample, however big it is.
+    // Zero disables the cache. Streaming samples are never cached.
+    void setCacheBudget (int64 bytes);
+    int64 getCacheBudget ();
+
+    Statistics getStatistics ();
+
+private:
+    using CacheEntry = std::pair<String, std::shared_ptr<const OurSample>>;
+
+    // Moves the sample to the front of the cache, adding it if need be, and
+    // then trims the cache to fit the budget. Returns the samples that were
+    // trimmed, so that they can be released once the lock is dropped.
+    std::vector<std::shared_ptr<const OurSample>> touch (const String& key, std::shared_ptr<const OurSample> sample);
+
+    std::vector<std::shared_ptr<const OurSample>> trimCache ();
+
+    // Forgets about samples that nobody is using any more.
+    void removeExpiredSamples ();
+
+    std::mutex mutex;
+    std::map<String, std::weak_ptr<const OurSample>> samples;
+    int64 hits = 0;
+    int64 misses = 0;
+
+    // Most recently used first.
+    std::list<CacheEntry> cache;
+    int64 cachedBytes = 0;
+    int64 cacheBudget = defaultCacheBudgetBytes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SamplePool)
+};
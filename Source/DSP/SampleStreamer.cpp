@@ -0,0 +1,193 @@
+#include "SampleStreamer.h"
+#include "../Trace.h"
+
+namespace
+{
+// The most frames the background thread will read into one stream before moving
+// on to the next, so that a single busy stream can't starve the others.
+constexpr int maxFramesPerRead = 4096;
+} // namespace
+
+SampleStreamer::SampleStreamer (int numStreams)
+    : Thread ("Sample streamer"),
+    numStreamsToAllocate (numStreams)
+{
+    static_assert (isPowerOfTwo ((int) ringLength), "The ring length must be a power of two");
+    static_assert ((int) ringLength > 2 * (int) ringOverlap, "The ring must be longer than the overlap");
+}
+
+void SampleStreamer::start ()
+{
+    if (! streams.empty ())
+        return;
+
+    // The audio thread sees the streams once it has been handed the streaming
+    // sample, which is published after this.
+    readBuffer.setSize (2, maxFramesPerRead);
+    streams.reserve ((size_t) numStreamsToAllocate);
+
+    for (auto i = 0; i < numStreamsToAllocate; ++i)
+        streams.push_back (std::make_unique<Stream> (2));
+
+    startThread (Thread::Priority::high);
+}
+
+SampleStreamer::~SampleStreamer ()
+{
+    stopThread (2000);
+}
+
+int SampleStreamer::startStream (std::shared_ptr<const OurSample> sample)
+{
+    jassert (sample != nullptr && sample->isStreaming ());
+
+    for (auto i = 0; i < (int) streams.size (); ++i)
+    {
+        auto& stream = *streams[(size_t) i];
+
+        if (stream.state.load (std::memory_order_acquire) != idle)
+            continue;
+
+        const auto firstFrame = (int64) jmax (0, sample->getNumResidentFrames () - (int) ringOverlap);
+
+        // The background thread doesn't touch an idle stream, so we're free to set
+        // it up here. Moving the shared_ptr in only bumps its reference count.
+        stream.sample = std::move (sample);
+        stream.firstFrame = firstFrame;
+        stream.readFrame.store (firstFrame, std::memory_order_relaxed);
+        stream.writtenEnd.store (firstFrame, std::memory_order_relaxed);
+        stream.state.store (active, std::memory_order_release);
+        return i;
+    }
+
+    numStreamsUnavailable.fetch_add (1, std::memory_order_relaxed);
+    return -1;
+}
+
+void SampleStreamer::stopStream (int stream)
+{
+    // The background thread releases the sample, so that we never end up
+    // destroying it here.
+    streams[(size_t) stream]->state.store (releasing, std::memory_order_release);
+}
+
+bool SampleStreamer::mapSegmentToRing (int streamIndex, RenderKernels::Segment& segment)
+{
+    auto& stream = *streams[(size_t) streamIndex];
+
+    if (segment.length == 0)
+        return true;
+
+    const auto firstNeeded = (int64) segment.positions[0] - guardLength;
+    const auto lastNeeded = (int64) segment.positions[segment.length - 1] + guardLength;
+
+    // Let the background thread know it can reuse everything before this segment.
+    if (firstNeeded > stream.readFrame.load (std::memory_order_relaxed))
+        stream.readFrame.store (firstNeeded, std::memory_order_release);
+
+    const auto available = firstNeeded >= stream.firstFrame
+                        && lastNeeded < stream.writtenEnd.load (std::memory_order_acquire)
+                        && lastNeeded - firstNeeded < (int64) ringLength;
+
+    if (! available)
+    {
+        numUnderruns.fetch_add (1, std::memory_order_relaxed);
+        RenderKernels::makeSilent (segment);
+        return false;
+    }
+
+    for (auto i = 0; i < segment.length; ++i)
+        segment.positions[i] &= (int) ringLength - 1;
+
+    return true;
+}
+
+//==============================================================================
+
+void SampleStreamer::run ()
+{
+    SAMPLER_TRACE_THREAD ("Sample streamer");
+
+    while (! threadShouldExit ())
+    {
+        auto didWork = false;
+        auto anyActive = false;
+
+        for (auto& stream : streams)
+        {
+            const auto state = stream->state.load (std::memory_order_acquire);
+
+            if (state == releasing)
+            {
+                // The audio thread has finished with this stream, so drop our
+                // reference to the sample and hand the stream back.
+                stream->sample = nullptr;
+                stream->state.store (idle, std::memory_order_release);
+            }
+            else if (state == active)
+            {
+                anyActive = true;
+                didWork = fillStream (*stream) || didWork;
+            }
+        }
+
+        // Poll quickly while voices are streaming, and lazily otherwise. A new
+        // stream always starts with a head's worth of frames in hand, so it can
+        // afford to wait a little for us to notice it.
+        if (! didWork)
+            wait (anyActive ? 1 : 10);
+    }
+}
+
+bool SampleStreamer::fillStream (Stream& stream)
+{
+    const auto& sample = *stream.sample;
+    const auto writtenEnd = stream.writtenEnd.load (std::memory_order_relaxed);
+
+    // Stay a ring's length ahead of the voice, but don't bother reading further
+    // than the guard frames after the end of the sample.
+    const auto limit = jmin (stream.readFrame.load (std::memory_order_acquire) + (int64) ringLength,
+                             (int64) sample.getLength () + guardLength + 1);
+
+    const auto numFrames = (int) jmin ((int64) maxFramesPerRead, limit - writtenEnd);
+
+    if (numFrames <= 0)
+        return false;
+
+    {
+        SAMPLER_TRACE_SCOPE ("stream read");
+        writeToRing (stream, writtenEnd, numFrames);
+    }
+
+    // Publishing the new end makes the frames we just wrote visible to the audio thread.
+    stream.writtenEnd.store (writtenEnd + numFrames, std::memory_order_release);
+    return true;
+}
+
+void SampleStreamer::writeToRing (Stream& stream, int64 startFrame, int numFrames)
+{
+    const auto& sample = *stream.sample;
+    const auto numChannels = sample.getNumChannels ();
+
+    // Refer to just the channels we need, without allocating.
+    AudioBuffer<float> source (readBuffer.getArrayOfWritePointers (), numChannels, numFrames);
+    sample.readFromSource (source, numFrames, startFrame);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        const auto* in = source.getReadPointer (channel);
+        auto* ring = stream.ring.getWritePointer (channel);
+
+        for (auto i = 0; i < numFrames; ++i)
+        {
+            const auto position = (int) ((startFrame + i) & ((int64) ringLength - 1));
+            ring[guardLength + position] = in[i];
+
+            // Mirror the frames at either end of the ring into the guard regions.
+            if (position < (int) guardLength)
+                ring[guardLength + ringLength + position] = in[i];
+            else if (position >= (int) ringLength - (int) guardLength)
+                ring[position - (ringLength - guardLength)] = in[i];
+        }
+    }
+}
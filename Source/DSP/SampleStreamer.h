@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Sampler.h"
+
+//==============================================================================
+// Feeds streaming samples to the voices that are playing them.
+//
+// There's a fixed pool of streams, each with its own ring buffer. When a voice
+// starts playing a streaming sample, the audio thread claims an idle stream, and
+// the background thread starts filling its ring from a little before the end of
+// the sample's in-memory head. The voice plays from the head until it reaches the
+// 'switch' frame, and from the ring after that. As it goes, it tells the stream
+// how far it has got, so that the background thread knows which frames it's free
+// to overwrite.
+//
+// The ring is padded on either side with copies of the frames at its opposite
+// end, so that an interpolator can read a few frames either side of any position
+// without having to worry about wrapping around.
+//
+// The audio thread never does any I/O, and never waits for the background
+// thread. If a voice catches up with the data that has been read so far, it
+// plays silence until the background thread catches up again, and the underrun
+// is counted. A voice that starts while every stream is busy only plays the
+// head, and that's counted separately.
+//
+// The rings take a few MB, so nothing is allocated, and the background thread
+// isn't started, until the first streaming sample comes along.
+class SampleStreamer final : private Thread
+{
+public:
+    enum
+    {
+        defaultNumStreams = 64,
+        ringLength = 1 << 14,
+        guardLength = OurSample::guardLength,
+
+        // The ring starts this many frames before the end of the head, and voices
+        // switch over to the ring halfway through this overlap.
+        ringOverlap = 4096,
+
+        // The smallest head that leaves room for the overlap.
+        minimumPreloadFrames = 2 * ringOverlap
+    };
+
+    explicit SampleStreamer (int numStreams = defaultNumStreams);
+    ~SampleStreamer () override;
+
+    // Message thread only. Allocates the streams and starts the background
+    // thread, unless that's been done already. This must be called before the
+    // audio thread is handed a streaming sample; until then, startStream has no
+    // streams to offer.
+    void start ();
+
+    //==============================================================================
+    // Audio thread only.
+
+    // Claims an idle stream for the given sample, and returns its index, or -1 if
+    // every stream is busy, in which case that's counted too.
+    int startStream (std::shared_ptr<const OurSample> sample);
+
+    // Returns the stream to the background thread, which will make it idle again
+    // once it has finished with it.
+    void stopStream (int stream);
+
+    // The first frame that must be read from the ring rather than the sample's head.
+    static int getSwitchFrame (const OurSample& sample)
+    {
+        return sample.getNumResidentFrames () - ringOverlap / 2;
+    }
+
+    // Rewrites the segment's positions so that they index into the stream's ring,
+    // whose channels are returned by getRingReadPointer(). This also tells the
+    // background thread that the frames before the segment are no longer needed.
+    // If the frames the segment needs haven't been read yet, the segment's levels
+    // are zeroed (so it renders silence), the underrun is counted, and this
+    // returns false.
+    bool mapSegmentToRing (int stream, RenderKernels::Segment& segment);
+
+    const float* getRingReadPointer (int stream, int channel) const
+    {
+        return streams[(size_t) stream]->ring.getReadPointer (channel, guardLength);
+    }
+
+    //==============================================================================
+    // Any thread.
+    int getNumUnderruns () const { return numUnderruns.load (); }
+
+    // The number of voices that couldn't get a stream, and so stopped at the
+    // end of their sample's head.
+    int getNumStreamsUnavailable () const { return numStreamsUnavailable.load (); }
+
+private:
+    enum State { idle, active, releasing };
+
+    struct Stream
+    {
+        explicit Stream (int numChannels)
+            : ring (numChannels, guardLength + ringLength + guardLength)
+        {
+            ring.clear ();
+        }
+
+        AudioBuffer<float> ring;
+        std::atomic<int> state { idle };
+
+        // Only written by the audio thread while the stream is idle.
+        std::shared_ptr<const OurSample> sample;
+        int64 firstFrame = 0;
+
+        // The earliest frame the voice might still read, written by the audio thread.
+        std::atomic<int64> readFrame { 0 };
+
+        // One past the last frame in the ring, written by the background thread.
+        std::atomic<int64> writtenEnd { 0 };
+    };
+
+    void run () override;
+
+    // Reads the next chunk of frames into the stream. Returns true if there was
+    // anything to read.
+    bool fillStream (Stream& stream);
+
+    void writeToRing (Stream& stream, int64 startFrame, int numFrames);
+
+    const int numStreamsToAllocate;
+    std::vector<std::unique_ptr<Stream>> streams;
+    AudioBuffer<float> readBuffer;
+    std::atomic<int> numUnderruns { 0 };
+    std::atomic<int> numStreamsUnavailable { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStreamer)
+};
@@ -9,38 +9,189 @@
 */
 
 #include "Sampler.h"
+#include "SamplerVoiceBank.h"
+#include "../Trace.h"
+
+OurSample::OurSample (AudioFormatReader& reader, double maxSampleLengthSecs, const ProgressCallback& progress) :
+    sourceSampleRate (reader.sampleRate),
+    length (jmin (int (reader.lengthInSamples), int (maxSampleLengthSecs * sourceSampleRate))),
+    residentLength (length),
+    data (jmin (2, int (reader.numChannels)), guardLength + residentLength + guardLength)
+{
+    readResidentFrames (reader, progress);
+}
+
+OurSample::OurSample (std::unique_ptr<AudioFormatReader> reader, int preloadFrames, const ProgressCallback& progress) :
+    sourceSampleRate (reader->sampleRate),
+    length (int (jmin (reader->lengthInSamples, (int64) std::numeric_limits<int>::max () - guardLength))),
+    residentLength (jmin (length, preloadFrames)),
+    data (jmin (2, int (reader->numChannels)), guardLength + residentLength + guardLength)
+{
+    readResidentFrames (*reader, progress);
+
+    // If the whole thing fitted in the head, there's nothing left to stream.
+    if (residentLength < length)
+        streamingReader = std::move (reader);
+}
+
+void OurSample::readResidentFrames (AudioFormatReader& reader, const ProgressCallback& progress)
+{
+    if (length == 0)
+        throw std::runtime_error ("Unable to load sample");
+
+    data.clear ();
+
+    // Decode in chunks, so that we can report progress (and be stopped) as we go.
+    constexpr auto framesPerChunk = 1 << 16;
+    const auto numFrames = residentLength + guardLength;
+
+    for (auto done = 0; done < numFrames;)
+    {
+        const auto numThisTime = jmin (framesPerChunk, numFrames - done);
+        reader.read (&data, guardLength + done, numThisTime, done, true, true);
+        done += numThisTime;
+
+        if (progress != nullptr && ! progress ((double) done / numFrames))
+            return;
+    }
+}
+
+void OurSample::readFromSource (AudioBuffer<float>& dest, int numFrames, int64 startFrame) const
+{
+    jassert (isStreaming ());
+    jassert (dest.getNumChannels () == getNumChannels ());
+
+    // Several streaming threads may share a sample, but a reader can only be used
+    // by one of them at a time.
+    const ScopedLock lock (streamingReaderLock);
+    streamingReader->read (&dest, 0, numFrames, startFrame, true, true);
+}
+
+//==============================================================================
+
+Keymap::Keymap (std::vector<SampleZone> zonesIn)
+    : zones (std::move (zonesIn))
+{
+    jassert (zones.size () < (size_t) std::numeric_limits<int16>::max ());
+
+    index.fill (-1);
+
+    for (auto zone = 0; zone < (int) zones.size (); ++zone)
+    {
+        const auto keys = zones[(size_t) zone].keys.getIntersectionWith ({ 0, 128 });
+        const auto velocities = zones[(size_t) zone].velocities.getIntersectionWith ({ 0, 128 });
+
+        for (auto note = keys.getStart (); note < keys.getEnd (); ++note)
+            for (auto velocity = velocities.getStart (); velocity < velocities.getEnd (); ++velocity)
+                index[(size_t) ((note << 7) | velocity)] = (int16) zone;
+    }
+}
+
+std::shared_ptr<const Keymap> Keymap::withSingleSample (std::shared_ptr<const OurSample> sample)
+{
+    if (sample == nullptr)
+        return std::make_shared<const Keymap> ();
+
+    SampleZone zone;
+    zone.sample = std::move (sample);
+
+    std::vector<SampleZone> zones;
+    zones.push_back (std::move (zone));
+    return std::make_shared<const Keymap> (std::move (zones));
+}
+
+//==============================================================================
+
+OurSamplerVoice::~OurSamplerVoice ()
+{
+    RealtimeDebug::noteDestruction ();
+
+    if (slot >= 0)
+        bank.releaseVoice (slot);
+}
 
 void OurSamplerVoice::noteStarted ()
 {
+    SAMPLER_TRACE_SCOPE ("voice start");
+
     jassert (currentlyPlayingNote.isValid ());
     jassert (currentlyPlayingNote.keyState == MPENote::keyDown
              || currentlyPlayingNote.keyState == MPENote::keyDownAndSustained);
 
-    level.setTargetValue (currentlyPlayingNote.noteOnVelocity.asUnsignedFloat ());
-    frequency.setTargetValue (currentlyPlayingNote.getFrequencyInHertz ());
+    if (slot >= 0)
+        bank.releaseVoice (slot);
+
+    slot = -1;
+
+    const auto* keymap = samplerSound->getKeymap ();
+    const auto* zone = keymap != nullptr ? keymap->findZone (currentlyPlayingNote.initialNote,
+                                                             currentlyPlayingNote.noteOnVelocity.as7BitInt ())
+                                         : nullptr;
+
+    // There's nothing to play for this note.
+    if (zone == nullptr)
+    {
+        clearCurrentNote ();
+        return;
+    }
 
-    for (auto smoothed : { &level, &frequency })
-        smoothed->reset (currentSampleRate, smoothingLengthInSeconds);
+    slot = bank.startVoice (*this,
+                            *samplerSound,
+                            *zone,
+                            currentSampleRate,
+                            currentlyPlayingNote.getFrequencyInHertz (),
+                            currentlyPlayingNote.noteOnVelocity.asUnsignedFloat (),
+                            currentlyPlayingNote.pressure.asUnsignedFloat ());
 
-    previousPressure = currentlyPlayingNote.pressure.asUnsignedFloat ();
-    currentSamplePos = 0.0;
-    tailOff = 0.0;
+    // There are as many slots as voices, so we should never run out.
+    jassert (slot >= 0);
+
+    if (slot < 0)
+        clearCurrentNote ();
 }
 
 void OurSamplerVoice::noteStopped (bool allowTailOff)
 {
+    SAMPLER_TRACE_SCOPE ("voice stop");
+
     jassert (currentlyPlayingNote.keyState == MPENote::off);
 
-    if (allowTailOff && approximatelyEqual (tailOff, 0.0))
-        tailOff = 1.0;
+    if (slot >= 0 && allowTailOff && ! bank.isTailingOff (slot))
+        bank.startTailOff (slot);
     else
         stopNote ();
 }
 
 void OurSamplerVoice::notePressureChanged ()
 {
-    const auto currentPressure = static_cast<double> (currentlyPlayingNote.pressure.asUnsignedFloat ());
-    const auto deltaPressure = currentPressure - previousPressure;
-    level.setTargetValue (jlimit (0.0, 1.0, level.getCurrentValue () + deltaPressure));
-    previousPressure = currentPressure;
+    if (slot >= 0)
+        bank.setPressure (slot, currentlyPlayingNote.pressure.asUnsignedFloat ());
+}
+
+void OurSamplerVoice::notePitchbendChanged ()
+{
+    if (slot >= 0)
+        bank.setTargetFrequency (slot, currentlyPlayingNote.getFrequencyInHertz ());
+}
+
+void OurSamplerVoice::releaseSlot ()
+{
+    if (slot >= 0)
+        bank.releaseVoice (slot);
+
+    slot = -1;
+}
+
+double OurSamplerVoice::getCurrentSamplePosition () const
+{
+    return slot >= 0 ? bank.getSamplePosition (slot) : 0.0;
+}
+
+void OurSamplerVoice::stopNote ()
+{
+    if (slot >= 0)
+        bank.releaseVoice (slot);
+
+    slot = -1;
+    clearCurrentNote ();
 }
@@ -3,32 +3,136 @@
 #include "juceHeader.h"
 using namespace juce;
 
+#include "Interpolation.h"
+#include "RenderKernels.h"
+#include "../RealtimeDebug.h"
+
+class PeakPyramid;
+
 //==============================================================================
 // Represents the constant parts of an audio sample: sample rate, length, and a copy of
 // the audio data itself, stored in an AudioBuffer. OurSamples might be pretty big,
 // so we'll keep shared_ptrs to them most of the time, to reduce duplication and copying.
+//
+// A streaming sample only keeps the first few frames (the 'head') in memory. The
+// rest is read from the source on demand by a SampleStreamer, which keeps a
+// window of frames ahead of each voice's playback position.
 class OurSample final
 {
 public:
-    OurSample (AudioFormatReader& reader, double maxSampleLengthSecs) :
-        sourceSampleRate (reader.sampleRate),
-        length (jmin (int (reader.lengthInSamples), int (maxSampleLengthSecs* sourceSampleRate))),
-        data (jmin (2, int (reader.numChannels)), length + 4)
-    {
-        if (length == 0)
-            throw std::runtime_error ("Unable to load sample");
+    // Called as decoding progresses, with the fraction done so far. Returning
+    // false stops decoding, leaving the rest of the sample silent.
+    using ProgressCallback = std::function<bool (double)>;
 
-        reader.read (&data, 0, length + 4, 0, true, true);
-    }
+    // Decodes the whole sample, up to maxSampleLengthSecs, into memory.
+    OurSample (AudioFormatReader& reader, double maxSampleLengthSecs,
+               const ProgressCallback& progress = nullptr);
+
+    // Decodes the first preloadFrames frames into memory, and keeps hold of the
+    // reader so that the rest can be streamed.
+    OurSample (std::unique_ptr<AudioFormatReader> streamingReader, int preloadFrames,
+               const ProgressCallback& progress = nullptr);
+
+    ~OurSample () { RealtimeDebug::noteDestruction (); }
+
+    // Interpolators may read up to half the widest kernel either side of the
+    // playback position, so the audio is padded with silence before the first
+    // frame, and with whatever follows the last frame in the file.
+    static constexpr int guardLength = maxInterpolationTaps / 2 + 1;
 
     double getSampleRate () const { return sourceSampleRate; }
     int getLength () const { return length; }
-    const AudioBuffer<float>& getBuffer () const { return data; }
+    int getNumChannels () const { return data.getNumChannels (); }
+
+    bool isStreaming () const { return streamingReader != nullptr; }
+
+    // The number of frames which are held in memory. For a streaming sample this
+    // is the length of the head, otherwise it's the same as getLength().
+    int getNumResidentFrames () const { return residentLength; }
+
+    // The size of the decoded audio held in memory.
+    int64 getMemoryUsageBytes () const
+    {
+        return (int64) data.getNumChannels () * data.getNumSamples () * (int64) sizeof (float);
+    }
+
+    // Returns a pointer to the first frame of the given channel. It's safe to
+    // read up to guardLength frames before the start and after the last resident frame.
+    const float* getReadPointer (int channel) const { return data.getReadPointer (channel, guardLength); }
+
+    // A summary of the sample's levels, for drawing its waveform. This is null
+    // until one has been attached. Neither is for the audio thread.
+    std::shared_ptr<const PeakPyramid> getPeakPyramid () const { return std::atomic_load (&peakPyramid); }
+
+    // The pyramid is built in the background once the sample is already playing,
+    // and it's only a cache, so it may be attached to a shared sample.
+    void setPeakPyramid (std::shared_ptr<const PeakPyramid> pyramid) const { std::atomic_store (&peakPyramid, std::move (pyramid)); }
+
+    // Streaming samples only. Reads frames from the source into the start of dest,
+    // which must have getNumChannels() channels. This may block, so it must never
+    // be called from the audio thread.
+    void readFromSource (AudioBuffer<float>& dest, int numFrames, int64 startFrame) const;
 
 private:
+    void readResidentFrames (AudioFormatReader& reader, const ProgressCallback& progress);
+
     double sourceSampleRate;
     int length;
+    int residentLength;
     AudioBuffer<float> data;
+
+    std::unique_ptr<AudioFormatReader> streamingReader;
+    CriticalSection streamingReaderLock;
+
+    mutable std::shared_ptr<const PeakPyramid> peakPyramid;
+};
+
+//==============================================================================
+// A sample, along with the notes and velocities it should be played for.
+struct SampleZone
+{
+    std::shared_ptr<const OurSample> sample;
+
+    // The note at which the sample plays back at its original pitch, or -1 to
+    // use the sound's centre frequency instead.
+    int rootNote = -1;
+
+    // Half-open ranges of MIDI note numbers and velocities.
+    Range<int> keys { 0, 128 };
+    Range<int> velocities { 0, 128 };
+};
+
+//==============================================================================
+// A set of zones, along with a precomputed table giving the zone to play for
+// every combination of note and velocity, so that finding a zone at note-on
+// takes constant time no matter how many zones there are.
+//
+// Keymaps are built off the audio thread, and never modified afterwards.
+// Where zones overlap, the one that comes last wins.
+class Keymap final
+{
+public:
+    Keymap () { index.fill (-1); }
+    explicit Keymap (std::vector<SampleZone> zones);
+    ~Keymap () { RealtimeDebug::noteDestruction (); }
+
+    // Returns a keymap which plays the same sample for every note and velocity.
+    static std::shared_ptr<const Keymap> withSingleSample (std::shared_ptr<const OurSample> sample);
+
+    // Returns the zone to play, or nullptr if no zone covers the note and velocity.
+    const SampleZone* findZone (int note, int velocity) const noexcept
+    {
+        jassert (isPositiveAndBelow (note, 128) && isPositiveAndBelow (velocity, 128));
+        const auto zone = index[(size_t) ((note << 7) | velocity)];
+        return zone >= 0 ? &zones[(size_t) zone] : nullptr;
+    }
+
+    int getNumZones () const { return (int) zones.size (); }
+    const SampleZone& getZone (int zone) const { return zones[(size_t) zone]; }
+
+private:
+    std::vector<SampleZone> zones;
+    std::array<int16, 128 * 128> index;
 };
 
 //==============================================================================
@@ -39,14 +143,23 @@ private:
 class OurSamplerSound final
 {
 public:
-    void setSample (std::unique_ptr<OurSample> value)
+    // The keymap must have been built on the message thread. This swaps it with
+    // the current one, so that the caller decides where the old one is destroyed.
+    void swapKeymap (std::shared_ptr<const Keymap>& value) noexcept
+    {
+        std::swap (keymap, value);
+    }
+
+    const Keymap* getKeymap () const
     {
-        sample = std::move (value);
+        return keymap.get ();
     }
 
-    OurSample* getSample () const
+    // The frequency at which the zone's sample plays back at its original pitch.
+    double getRootFrequencyInHz (const SampleZone& zone) const
     {
-        return sample.get ();
+        return zone.rootNote >= 0 ? MidiMessage::getMidiNoteInHertz (zone.rootNote)
+                                  : centreFrequencyInHz;
     }
 
     void setCentreFrequencyInHz (double centre)
@@ -59,162 +172,88 @@ public:
         return centreFrequencyInHz;
     }
 
+    void setInterpolationMode (InterpolationMode mode)
+    {
+        interpolationMode = mode;
+    }
+
+    InterpolationMode getInterpolationMode () const
+    {
+        return interpolationMode;
+    }
+
+    // The tables are owned by the processor, which must outlive this sound.
+    void setSincTables (const SincTables* tables)
+    {
+        sincTables = tables;
+    }
+
+    const SincTables& getSincTables () const
+    {
+        jassert (sincTables != nullptr);
+        return *sincTables;
+    }
+
 private:
-    std::unique_ptr<OurSample> sample;
+    std::shared_ptr<const Keymap> keymap;
     double centreFrequencyInHz { 440.0 };
+    InterpolationMode interpolationMode { InterpolationMode::linear };
+    const SincTables* sincTables = nullptr;
 };
 
 //==============================================================================
+class SamplerVoiceBank;
+
+// The synthesiser's view of a voice. The playback state itself lives in a
+// SamplerVoiceBank slot, which this voice claims when its note starts, and which
+// is rendered by the bank along with all of the other active slots.
 class OurSamplerVoice final : public MPESynthesiserVoice
 {
 public:
-    explicit OurSamplerVoice (std::shared_ptr<const OurSamplerSound> sound) :
-        samplerSound (std::move (sound))    //moving the shared pointer param into our member is faster than copying it
+    OurSamplerVoice (std::shared_ptr<const OurSamplerSound> sound, SamplerVoiceBank& bankIn) :
+        samplerSound (std::move (sound)),    //moving the shared pointer param into our member is faster than copying it
+        bank (bankIn)
     {
         jassert (samplerSound != nullptr);
     }
 
+    ~OurSamplerVoice () override;
+
     void noteStarted () override;
 
     void noteStopped (bool allowTailOff) override;
 
     void notePressureChanged () override;
 
-    void notePitchbendChanged () override
-    {
-        frequency.setTargetValue (currentlyPlayingNote.getFrequencyInHertz ());
-    }
+    void notePitchbendChanged () override;
 
     void noteTimbreChanged ()   override {}
     void noteKeyStateChanged () override {}
 
-    void renderNextBlock (AudioBuffer<float>& outputBuffer,
-                          int startSample,
-                          int numSamples) override
-    {
-        render (outputBuffer, startSample, numSamples);
-    }
+    // The SamplerSynthesiser renders all voices through the bank, so there's
+    // nothing to do here.
+    void renderNextBlock (AudioBuffer<float>&, int, int) override {}
+    void renderNextBlock (AudioBuffer<double>&, int, int) override {}
 
-    void renderNextBlock (AudioBuffer<double>& outputBuffer,
-                          int startSample,
-                          int numSamples) override
-    {
-        render (outputBuffer, startSample, numSamples);
-    }
+    double getCurrentSamplePosition () const;
 
-    double getCurrentSamplePosition () const
-    {
-        return currentSamplePos;
-    }
+    // Gives up our slot in the bank, if we have one, so that this voice can be
+    // destroyed on another thread.
+    void releaseSlot ();
 
 private:
-    template <typename Element>
-    void render (AudioBuffer<Element>& outputBuffer, int startSample, int numSamples);
+    friend class SamplerVoiceBank;
 
-    template <typename Element>
-    bool renderNextSample (const float* inL,
-                           const float* inR,
-                           Element* outL,
-                           Element* outR,
-                           size_t writePos);
-
-    bool isTailingOff () const { return ! approximatelyEqual (tailOff, 0.0); }
-
-    void stopNote ()
+    // Called by the bank when our slot has finished playing.
+    void slotFinished ()
     {
+        slot = -1;
         clearCurrentNote ();
-        currentSamplePos = 0.0;
     }
 
-    double getNextState (double freq) const
-    {
-        auto nextPitchRatio = freq / samplerSound->getCentreFrequencyInHz ();
-
-        auto nextSamplePos = currentSamplePos;
-        nextSamplePos += nextPitchRatio;
-        return nextSamplePos;
-    }
+    void stopNote ();
 
     std::shared_ptr<const OurSamplerSound> samplerSound;
-    SmoothedValue<double> level { 0 };
-    SmoothedValue<double> frequency { 0 };
-    double previousPressure { 0 };
-    double currentSamplePos { 0 };
-    double tailOff { 0 };
-    double smoothingLengthInSeconds { 0.01 };
+    SamplerVoiceBank& bank;
+    int slot = -1;
 };
-
-//=================================================================================
-
-template<typename Element>
-void OurSamplerVoice::render (AudioBuffer<Element>& outputBuffer, int startSample, int numSamples)
-{
-    jassert (samplerSound->getSample () != nullptr);
-
-    auto& data = samplerSound->getSample ()->getBuffer ();
-
-    auto inL = data.getReadPointer (0);
-    auto inR = data.getNumChannels () > 1 ? data.getReadPointer (1) : nullptr;
-
-    auto outL = outputBuffer.getWritePointer (0, startSample);
-
-    if (outL == nullptr)
-        return;
-
-    auto outR = outputBuffer.getNumChannels () > 1 ? outputBuffer.getWritePointer (1, startSample)
-        : nullptr;
-
-    size_t writePos = 0;
-
-    while (--numSamples >= 0 && renderNextSample (inL, inR, outL, outR, writePos))
-        writePos += 1;
-}
-
-template<typename Element>
-bool OurSamplerVoice::renderNextSample (const float* inL, const float* inR, Element* outL, Element* outR, size_t writePos)
-{
-    auto currentLevel = level.getNextValue ();
-    auto currentFrequency = frequency.getNextValue ();
-
-    if (isTailingOff ())
-    {
-        currentLevel *= tailOff;
-        tailOff *= 0.9999;
-
-        if (tailOff < 0.005)
-        {
-            stopNote ();
-            return false;
-        }
-    }
-
-    auto pos = (int) currentSamplePos;
-    auto nextPos = pos + 1;
-    auto alpha = (Element) (currentSamplePos - pos);
-    auto invAlpha = 1.0f - alpha;
-
-    // just using a very simple linear interpolation here..
-    auto l = static_cast<Element> (currentLevel * (inL[pos] * invAlpha + inL[nextPos] * alpha));
-    auto r = static_cast<Element> ((inR != nullptr) ? currentLevel * (inR[pos] * invAlpha + inR[nextPos] * alpha)
-                                   : l);
-
-    if (outR != nullptr)
-    {
-        outL[writePos] += l;
-        outR[writePos] += r;
-    }
-    else
-    {
-        outL[writePos] += (l + r) * 0.5f;
-    }
-
-    currentSamplePos = getNextState (currentFrequency);
-
-    if (currentSamplePos > samplerSound->getSample ()->getLength ())
-    {
-        stopNote ();
-        return false;
-    }
-
-    return true;
-}
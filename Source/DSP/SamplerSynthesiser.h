@@ -0,0 +1,106 @@
+#pragma once
+
+#include "SamplerVoiceBank.h"
+#include "ParallelVoiceRenderer.h"
+#include "../RetireQueue.h"
+
+//==============================================================================
+// An MPESynthesiser that renders all of its voices through a SamplerVoiceBank,
+// instead of asking each voice to render itself. When there are enough active
+// voices, the bank is split across the ParallelVoiceRenderer's worker threads.
+//
+// All of the voices must be OurSamplerVoices.
+class SamplerSynthesiser final : public MPESynthesiser
+{
+public:
+    SamplerSynthesiser (SamplerVoiceBank& bankIn, ParallelVoiceRenderer& parallelRendererIn, int maxVoices)
+        : bank (bankIn),
+        parallelRenderer (parallelRendererIn)
+    {
+        // Allocating enough room up front means that adding and removing voices
+        // on the audio thread never touches the heap.
+        voices.ensureStorageAllocated (maxVoices);
+        spareVoices.ensureStorageAllocated (maxVoices);
+    }
+
+    // Call this on the audio thread, after turning off all the voices. Gives up
+    // every voice's slot in the bank, so that nothing refers to the current
+    // keymap any more, while keeping the voices themselves for reuse.
+    void releaseVoiceSlots ()
+    {
+        const ScopedLock sl (voicesLock);
+
+        for (auto* voice : voices)
+            static_cast<OurSamplerVoice*> (voice)->releaseSlot ();
+    }
+
+    // Call this on the audio thread instead of reduceNumVoices() or clearVoices().
+    // Removes all but numToKeep voices, preferring to keep the ones that are
+    // playing, and hands the others to the queue rather than deleting them.
+    void retireVoices (int numToKeep, RetireQueue<OurSamplerVoice>& retired)
+    {
+        const ScopedLock sl (voicesLock);
+
+        if (voices.size () <= numToKeep)
+            return;
+
+        // Swapping the arrays moves every voice across without reallocating
+        // either of them. Then we move back the ones we're keeping.
+        voices.swapWith (spareVoices);
+
+        for (auto keepActive : { true, false })
+        {
+            for (auto i = 0; i < spareVoices.size () && voices.size () < numToKeep; ++i)
+            {
+                auto* voice = spareVoices.getUnchecked (i);
+
+                if (voice != nullptr && voice->isActive () == keepActive)
+                {
+                    spareVoices.set (i, nullptr, false);
+                    voices.add (voice);
+                }
+            }
+        }
+
+        for (auto* voice : spareVoices)
+        {
+            if (auto* ourVoice = static_cast<OurSamplerVoice*> (voice))
+            {
+                ourVoice->releaseSlot ();
+                retired.retire (std::unique_ptr<OurSamplerVoice> (ourVoice));
+            }
+        }
+
+        spareVoices.clearQuick (false);
+    }
+
+protected:
+    void renderNextSubBlock (AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+    {
+        renderBank (outputAudio, startSample, numSamples);
+    }
+
+    void renderNextSubBlock (AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+    {
+        renderBank (outputAudio, startSample, numSamples);
+    }
+
+private:
+    template <typename Element>
+    void renderBank (AudioBuffer<Element>& outputAudio, int startSample, int numSamples)
+    {
+        // Whatever renderNextBlock was allowed to do, the voices aren't.
+        const RealtimeDebug::ScopedNoPermissions ownCode;
+
+        if (parallelRenderer.render (bank, outputAudio, startSample, numSamples))
+            bank.releaseFinishedVoices ();
+        else
+            bank.render (outputAudio, startSample, numSamples);
+    }
+
+    SamplerVoiceBank& bank;
+    ParallelVoiceRenderer& parallelRenderer;
+
+    // Always empty between calls to retireVoices().
+    OwnedArray<MPESynthesiserVoice> spareVoices;
+};
@@ -0,0 +1,242 @@
+#include "SamplerVoiceBank.h"
+
+void SamplerVoiceBank::Smoothers::allocate (int capacity)
+{
+    for (auto* array : { &currents, &targets, &steps })
+        array->assign ((size_t) capacity, 0.0);
+
+    countdowns.assign ((size_t) capacity, 0);
+    rampLengths.assign ((size_t) capacity, 0);
+}
+
+void SamplerVoiceBank::Smoothers::reset (int slot, double value, int rampLengthInSamples)
+{
+    const auto i = (size_t) slot;
+    currents[i] = targets[i] = value;
+    steps[i] = 0.0;
+    countdowns[i] = 0;
+    rampLengths[i] = rampLengthInSamples;
+}
+
+void SamplerVoiceBank::Smoothers::setTarget (int slot, double value)
+{
+    const auto i = (size_t) slot;
+
+    if (approximatelyEqual (value, targets[i]))
+        return;
+
+    if (rampLengths[i] <= 0)
+    {
+        currents[i] = targets[i] = value;
+        countdowns[i] = 0;
+        return;
+    }
+
+    targets[i] = value;
+    countdowns[i] = rampLengths[i];
+    steps[i] = (targets[i] - currents[i]) / countdowns[i];
+}
+
+//==============================================================================
+
+SamplerVoiceBank::SamplerVoiceBank (int capacity, SampleStreamer* streamerIn)
+    : streamer (streamerIn)
+{
+    jassert (capacity > 0);
+
+    for (auto* array : { &positions, &tailOffs, &previousPressures })
+        array->assign ((size_t) capacity, 0.0);
+
+    levels.allocate (capacity);
+    frequencies.allocate (capacity);
+
+    sounds.assign ((size_t) capacity, nullptr);
+    zones.assign ((size_t) capacity, nullptr);
+    owners.assign ((size_t) capacity, nullptr);
+    streamIndices.assign ((size_t) capacity, -1);
+    activeMask.assign ((size_t) capacity, 0);
+    finishedMask.assign ((size_t) capacity, 0);
+    activeSlots.assign ((size_t) capacity, -1);
+    freeSlots.resize ((size_t) capacity);
+
+    // Hand out low slot numbers first, so that a lightly-loaded bank only
+    // touches the start of each array.
+    for (auto i = 0; i < capacity; ++i)
+        freeSlots[(size_t) i] = capacity - 1 - i;
+
+    numFree = capacity;
+}
+
+int SamplerVoiceBank::startVoice (OurSamplerVoice& owner,
+                                  const OurSamplerSound& sound,
+                                  const SampleZone& zone,
+                                  double sampleRate,
+                                  double frequency,
+                                  double level,
+                                  double pressure)
+{
+    jassert (zone.sample != nullptr);
+
+    if (numFree == 0)
+        return -1;
+
+    const auto slot = freeSlots[(size_t) --numFree];
+    const auto i = (size_t) slot;
+    const auto rampLength = (int) std::floor (smoothingLengthInSeconds * sampleRate);
+
+    levels.reset (slot, level, rampLength);
+    frequencies.reset (slot, frequency, rampLength);
+
+    positions[i] = 0.0;
+    tailOffs[i] = 0.0;
+    previousPressures[i] = pressure;
+    sounds[i] = &sound;
+    zones[i] = &zone;
+    owners[i] = &owner;
+
+    if (streamer != nullptr && zone.sample->isStreaming ())
+        streamIndices[i] = streamer->startStream (zone.sample);
+
+    activeMask[i] = 1;
+    finishedMask[i] = 0;
+    activeSlots[(size_t) numActive++] = slot;
+
+    return slot;
+}
+
+void SamplerVoiceBank::releaseVoice (int slot)
+{
+    const auto i = (size_t) slot;
+
+    if (activeMask[i] == 0)
+        return;
+
+    // Keep the active list dense by moving the last entry into the hole.
+    for (auto n = 0; n < numActive; ++n)
+    {
+        if (activeSlots[(size_t) n] == slot)
+        {
+            activeSlots[(size_t) n] = activeSlots[(size_t) --numActive];
+            break;
+        }
+    }
+
+    activeMask[i] = 0;
+    finishedMask[i] = 0;
+    positions[i] = 0.0;
+    sounds[i] = nullptr;
+    zones[i] = nullptr;
+    owners[i] = nullptr;
+
+    if (streamIndices[i] >= 0)
+        streamer->stopStream (streamIndices[i]);
+
+    streamIndices[i] = -1;
+    freeSlots[(size_t) numFree++] = slot;
+}
+
+void SamplerVoiceBank::startTailOff (int slot)
+{
+    tailOffs[(size_t) slot] = 1.0;
+}
+
+void SamplerVoiceBank::setTargetFrequency (int slot, double frequency)
+{
+    frequencies.setTarget (slot, frequency);
+}
+
+void SamplerVoiceBank::setPressure (int slot, double pressure)
+{
+    const auto i = (size_t) slot;
+    const auto deltaPressure = pressure - previousPressures[i];
+    levels.setTarget (slot, jlimit (0.0, 1.0, levels.currents[i] + deltaPressure));
+    previousPressures[i] = pressure;
+}
+
+bool SamplerVoiceBank::prepareSegment (int slot, RenderKernels::Segment& segment, int maxLength, double boundary)
+{
+    const auto i = (size_t) slot;
+    const auto& zone = *zones[i];
+    const auto sampleLength = (double) zone.sample->getLength ();
+    const auto centreFrequency = sounds[i]->getRootFrequencyInHz (zone);
+    const auto smoothing = levels.isSmoothing (slot) || frequencies.isSmoothing (slot);
+
+    // Pull the state for this slot into locals for the duration of the segment.
+    auto position = positions[i];
+    auto tailOff = tailOffs[i];
+    const auto tailingOff = ! approximatelyEqual (tailOff, 0.0);
+
+    // When neither smoother is moving, the gain and increment are constant over
+    // the whole segment, so we can avoid stepping the smoothers for each sample.
+    auto currentLevel = levels.targets[i];
+    auto increment = frequencies.targets[i] / centreFrequency;
+
+    auto finished = false;
+    auto n = 0;
+
+    for (; n < maxLength; ++n)
+    {
+        if (smoothing)
+        {
+            currentLevel = levels.getNext (slot);
+            increment = frequencies.getNext (slot) / centreFrequency;
+        }
+
+        auto gain = currentLevel;
+
+        if (tailingOff)
+        {
+            gain *= tailOff;
+            tailOff *= 0.9999;
+
+            if (tailOff < 0.005)
+            {
+                finished = true;
+                break;
+            }
+        }
+
+        const auto pos = (int) position;
+        segment.positions[n] = pos;
+        segment.fractions[n] = (float) (position - pos);
+        segment.levels[n] = (float) gain;
+
+        position += increment;
+
+        if (position > sampleLength)
+        {
+            finished = true;
+            ++n;
+            break;
+        }
+
+        if (position >= boundary)
+        {
+            ++n;
+            break;
+        }
+    }
+
+    positions[i] = position;
+    tailOffs[i] = tailOff;
+    segment.length = n;
+
+    return ! finished;
+}
+
+void SamplerVoiceBank::releaseFinishedVoices ()
+{
+    for (auto n = numActive; --n >= 0;)
+    {
+        const auto slot = activeSlots[(size_t) n];
+
+        if (finishedMask[(size_t) slot] == 0)
+            continue;
+
+        auto* owner = owners[(size_t) slot];
+        releaseVoice (slot);
+
+        if (owner != nullptr)
+            owner->slotFinished ();
+    }
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "Sampler.h"
+#include "SampleStreamer.h"
+
+//==============================================================================
+// Holds the playback state of every sounding voice in a set of flat arrays,
+// indexed by 'slot', so that the whole bank can be rendered in one pass without
+// chasing a pointer (and calling a virtual function) per voice.
+//
+// OurSamplerVoice objects still receive the MPE note callbacks from the
+// synthesiser, but they're just handles: when a note starts, the voice claims a
+// free slot here, and forwards all subsequent expression changes to that slot.
+// When the slot finishes playing, the bank tells its owning voice so that the
+// synthesiser sees the voice as free again.
+//
+// Everything in here is called on the audio thread. The arrays are allocated
+// once, up front, with room for the largest number of voices we'll ever use.
+//
+// Voices playing streaming samples get their frames from the SampleStreamer once
+// they've played past the sample's in-memory head. A voice that couldn't get a
+// stream finishes there instead.
+class SamplerVoiceBank final
+{
+public:
+    explicit SamplerVoiceBank (int capacity, SampleStreamer* streamer = nullptr);
+
+    // Claims a free slot, and initialises it to start playing from the beginning
+    // of the zone's sample. The zone must belong to the sound's current keymap.
+    // Returns -1 if every slot is in use.
+    int startVoice (OurSamplerVoice& owner,
+                    const OurSamplerSound& sound,
+                    const SampleZone& zone,
+                    double sampleRate,
+                    double frequency,
+                    double level,
+                    double pressure);
+
+    // Returns the slot to the free list immediately, without any tail-off.
+    void releaseVoice (int slot);
+
+    void startTailOff (int slot);
+    bool isTailingOff (int slot) const { return ! approximatelyEqual (tailOffs[(size_t) slot], 0.0); }
+
+    void setTargetFrequency (int slot, double frequency);
+    void setPressure (int slot, double pressure);
+
+    double getSamplePosition (int slot) const { return positions[(size_t) slot]; }
+
+    double getPlaybackPositionSeconds (int slot) const
+    {
+        const auto& sample = *zones[(size_t) slot]->sample;
+        return positions[(size_t) slot] / sample.getSampleRate ();
+    }
+
+    int getNumActiveVoices () const { return numActive; }
+    int getActiveSlot (int index) const { return activeSlots[(size_t) index]; }
+
+    // Adds every active voice into the buffer, then releases any voices which
+    // finished during the block.
+    template <typename Element>
+    void render (AudioBuffer<Element>& outputBuffer, int startSample, int numSamples);
+
+    // Adds a single slot into the buffer. Different slots may be rendered
+    // concurrently on different threads, as long as each thread has its own
+    // output buffer, and releaseFinishedVoices() is called once they're all done.
+    template <typename Element>
+    void renderVoice (int slot, AudioBuffer<Element>& outputBuffer, int startSample, int numSamples);
+
+    void releaseFinishedVoices ();
+
+private:
+    // Linear smoothing with the same behaviour as SmoothedValue<double>, but with
+    // its state spread across parallel arrays.
+    struct Smoothers
+    {
+        void allocate (int capacity);
+        void reset (int slot, double value, int rampLengthInSamples);
+        void setTarget (int slot, double value);
+        bool isSmoothing (int slot) const { return countdowns[(size_t) slot] > 0; }
+
+        double getNext (int slot)
+        {
+            const auto i = (size_t) slot;
+
+            if (countdowns[i] <= 0)
+                return targets[i];
+
+            --countdowns[i];
+            currents[i] = countdowns[i] > 0 ? currents[i] + steps[i] : targets[i];
+            return currents[i];
+        }
+
+        std::vector<double> currents, targets, steps;
+        std::vector<int> countdowns, rampLengths;
+    };
+
+    // Works out the read positions and gains for up to maxLength samples of the
+    // given slot. Returns false if the voice finished within the segment, in which
+    // case segment.length may be less than maxLength. The segment also ends early
+    // (but the voice doesn't finish) once the position reaches 'boundary'.
+    bool prepareSegment (int slot, RenderKernels::Segment& segment, int maxLength, double boundary);
+
+    std::vector<double> positions;
+    std::vector<double> tailOffs;
+    std::vector<double> previousPressures;
+    Smoothers levels, frequencies;
+
+    std::vector<const OurSamplerSound*> sounds;
+
+    // A keymap is only ever replaced along with all of the voices, so these
+    // can't outlive the keymap they point into.
+    std::vector<const SampleZone*> zones;
+    std::vector<OurSamplerVoice*> owners;
+
+    SampleStreamer* streamer;
+    std::vector<int> streamIndices;
+
+    std::vector<uint8_t> activeMask, finishedMask;
+    std::vector<int> activeSlots, freeSlots;
+    int numActive = 0, numFree = 0;
+
+    static constexpr double smoothingLengthInSeconds = 0.01;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SamplerVoiceBank)
+};
+
+//=================================================================================
+
+template<typename Element>
+void SamplerVoiceBank::render (AudioBuffer<Element>& outputBuffer, int startSample, int numSamples)
+{
+    for (auto i = 0; i < numActive; ++i)
+        renderVoice (activeSlots[(size_t) i], outputBuffer, startSample, numSamples);
+
+    releaseFinishedVoices ();
+}
+
+template<typename Element>
+void SamplerVoiceBank::renderVoice (int slot, AudioBuffer<Element>& outputBuffer, int startSample, int numSamples)
+{
+    auto& sound = *sounds[(size_t) slot];
+    auto& data = *zones[(size_t) slot]->sample;
+
+    auto inL = data.getReadPointer (0);
+    auto inR = data.getNumChannels () > 1 ? data.getReadPointer (1) : nullptr;
+
+    // Once a streaming voice passes this frame, it reads from its stream's ring
+    // rather than from the sample's head.
+    const auto switchFrame = data.isStreaming () ? SampleStreamer::getSwitchFrame (data)
+                                                 : std::numeric_limits<int>::max ();
+    const auto stream = streamIndices[(size_t) slot];
+
+    const auto mode = sound.getInterpolationMode ();
+    auto& tables = sound.getSincTables ();
+
+    auto outL = outputBuffer.getWritePointer (0, startSample);
+
+    if (outL == nullptr)
+        return;
+
+    auto outR = outputBuffer.getNumChannels () > 1 ? outputBuffer.getWritePointer (1, startSample)
+        : nullptr;
+
+    RenderKernels::Segment segment;
+    alignas (32) float left[RenderKernels::maxSegmentLength];
+    alignas (32) float right[RenderKernels::maxSegmentLength];
+
+    while (numSamples > 0)
+    {
+        // We couldn't get a stream when the note started, so there's nothing to
+        // play past the head. Rather than hold on to a silent voice, stop it.
+        // The streamer has already counted it.
+        if (stream < 0 && positions[(size_t) slot] >= switchFrame)
+        {
+            finishedMask[(size_t) slot] = 1;
+            break;
+        }
+
+        const auto wanted = jmin (numSamples, RenderKernels::maxSegmentLength);
+        const auto boundary = positions[(size_t) slot] < switchFrame ? (double) switchFrame
+                                                                     : std::numeric_limits<double>::max ();
+        const auto finished = ! prepareSegment (slot, segment, wanted, boundary);
+        const auto length = segment.length;
+
+        auto sourceL = inL;
+        auto sourceR = inR;
+
+        if (length > 0 && segment.positions[0] >= switchFrame)
+        {
+            streamer->mapSegmentToRing (stream, segment);
+            sourceL = streamer->getRingReadPointer (stream, 0);
+            sourceR = inR != nullptr ? streamer->getRingReadPointer (stream, 1) : nullptr;
+        }
+
+        RenderKernels::renderInterpolated (mode, tables, sourceL, segment, left);
+
+        if (sourceR != nullptr)
+            RenderKernels::renderInterpolated (mode, tables, sourceR, segment, right);
+
+        if (outR != nullptr)
+        {
+            RenderKernels::accumulate (outL, left, length);
+            RenderKernels::accumulate (outR, inR != nullptr ? right : left, length);
+            outR += length;
+        }
+        else if (inR != nullptr)
+        {
+            RenderKernels::accumulateAverage (outL, left, right, length);
+        }
+        else
+        {
+            RenderKernels::accumulate (outL, left, length);
+        }
+
+        outL += length;
+        numSamples -= length;
+
+        if (finished)
+        {
+            finishedMask[(size_t) slot] = 1;
+            break;
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DSP/AudioFormatReaderFactory.h"
+#include "DSP/ParallelVoiceRenderer.h"
 
 class MPESettingsDataModel final : private ValueTree::Listener
 {
@@ -195,6 +196,20 @@ private:
 
 //==============================================================================
 
+// What we know about the current sample, without having to open it again.
+struct SampleMetadata
+{
+    int64 lengthInSamples = 0;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int bitsPerSample = 0;
+
+    bool isValid () const { return lengthInSamples > 0 && sampleRate > 0.0; }
+    double getLengthSeconds () const { return isValid () ? (double) lengthInSamples / sampleRate : 0.0; }
+};
+
+//==============================================================================
+
 class DataModel final : private ValueTree::Listener
 {
 public:
@@ -204,6 +219,10 @@ public:
         virtual ~Listener () noexcept = default;
         virtual void sampleReaderChanged (std::shared_ptr<AudioFormatReaderFactory>) {}
         virtual void centreFrequencyHzChanged (double) {}
+        virtual void interpolationModeChanged (InterpolationMode) {}
+        virtual void renderThreadsChanged (int) {}
+        virtual void streamFromDiskChanged (bool) {}
+        virtual void streamPreloadSecondsChanged (double) {}
     };
 
     explicit DataModel (AudioFormatManager& audioFormatManagerIn)
@@ -215,7 +234,11 @@ public:
         : audioFormatManager (&audioFormatManagerIn),
         valueTree (vt),
         sampleReader (valueTree, IDs::sampleReader, nullptr),
-        centreFrequencyHz (valueTree, IDs::centreFrequencyHz, nullptr)
+        centreFrequencyHz (valueTree, IDs::centreFrequencyHz, nullptr),
+        interpolationMode (valueTree, IDs::interpolationMode, nullptr, (int) InterpolationMode::linear),
+        renderThreads (valueTree, IDs::renderThreads, nullptr, 0),
+        streamFromDisk (valueTree, IDs::streamFromDisk, nullptr, false),
+        streamPreloadSeconds (valueTree, IDs::streamPreloadSeconds, nullptr, 1.0)
     {
         jassert (valueTree.hasType (IDs::DATA_MODEL));
         valueTree.addListener (this);
@@ -244,12 +267,38 @@ public:
         sampleReader.setValue (std::move (readerFactory), undoManager);
     }
 
-    double getSampleLengthSeconds () const
+    std::shared_ptr<AudioFormatReaderFactory> getSampleReaderFactory () const
+    {
+        return sampleReader;
+    }
+
+    // The sample's header is only read the first time this is called after the
+    // reader changes, and after that it's free to call. Nothing is decoded, so
+    // it's quick enough for the message thread. The peak level comes from the
+    // loaded sample's PeakPyramid instead, which is built in the background.
+    const SampleMetadata& getSampleMetadata () const
     {
-        if (auto r = getSampleReader ())
-            return (double) r->lengthInSamples / r->sampleRate;
+        if (metadataFactory != sampleReader.get ())
+        {
+            metadataFactory = sampleReader;
+            metadata = {};
+
+            if (auto r = getSampleReader ())
+            {
+                metadata.lengthInSamples = r->lengthInSamples;
+                metadata.sampleRate = r->sampleRate;
+                metadata.numChannels = (int) r->numChannels;
+                metadata.bitsPerSample = (int) r->bitsPerSample;
+            }
+        }
 
-        return 1.0;
+        return metadata;
+    }
+
+    double getSampleLengthSeconds () const
+    {
+        const auto& m = getSampleMetadata ();
+        return m.isValid () ? m.getLengthSeconds () : 1.0;
     }
 
     double getCentreFrequencyHz () const
@@ -263,6 +312,48 @@ public:
                                     undoManager);
     }
 
+    InterpolationMode getInterpolationMode () const
+    {
+        return (InterpolationMode) jlimit ((int) InterpolationMode::linear,
+                                           (int) InterpolationMode::sinc32,
+                                           interpolationMode.get ());
+    }
+
+    void setInterpolationMode (InterpolationMode value, UndoManager* undoManager)
+    {
+        interpolationMode.setValue ((int) value, undoManager);
+    }
+
+    int getRenderThreads () const
+    {
+        return renderThreads;
+    }
+
+    void setRenderThreads (int value, UndoManager* undoManager)
+    {
+        renderThreads.setValue (Range<int> (0, ParallelVoiceRenderer::maxThreads).clipValue (value), undoManager);
+    }
+
+    bool getStreamFromDisk () const
+    {
+        return streamFromDisk;
+    }
+
+    void setStreamFromDisk (bool value, UndoManager* undoManager)
+    {
+        streamFromDisk.setValue (value, undoManager);
+    }
+
+    double getStreamPreloadSeconds () const
+    {
+        return streamPreloadSeconds;
+    }
+
+    void setStreamPreloadSeconds (double value, UndoManager* undoManager)
+    {
+        streamPreloadSeconds.setValue (Range<double> (0.25, 10.0).clipValue (value), undoManager);
+    }
+
     MPESettingsDataModel mpeSettings ()
     {
         return MPESettingsDataModel (valueTree.getOrCreateChildWithName (IDs::MPE_SETTINGS, nullptr));
@@ -302,6 +393,26 @@ private:
             centreFrequencyHz.forceUpdateOfCachedValue ();
             listenerList.call ([this](Listener& l) { l.centreFrequencyHzChanged (centreFrequencyHz); });
         }
+        else if (property == IDs::interpolationMode)
+        {
+            interpolationMode.forceUpdateOfCachedValue ();
+            listenerList.call ([this](Listener& l) { l.interpolationModeChanged (getInterpolationMode ()); });
+        }
+        else if (property == IDs::renderThreads)
+        {
+            renderThreads.forceUpdateOfCachedValue ();
+            listenerList.call ([this](Listener& l) { l.renderThreadsChanged (renderThreads); });
+        }
+        else if (property == IDs::streamFromDisk)
+        {
+            streamFromDisk.forceUpdateOfCachedValue ();
+            listenerList.call ([this](Listener& l) { l.streamFromDiskChanged (streamFromDisk); });
+        }
+        else if (property == IDs::streamPreloadSeconds)
+        {
+            streamPreloadSeconds.forceUpdateOfCachedValue ();
+            listenerList.call ([this](Listener& l) { l.streamPreloadSecondsChanged (streamPreloadSeconds); });
+        }
     }
 
     void valueTreeChildAdded (ValueTree&, ValueTree&)      override {}
@@ -315,6 +426,14 @@ private:
 
     CachedValue<std::shared_ptr<AudioFormatReaderFactory>> sampleReader;
     CachedValue<double> centreFrequencyHz;
+    CachedValue<int> interpolationMode;
+    CachedValue<int> renderThreads;
+    CachedValue<bool> streamFromDisk;
+    CachedValue<double> streamPreloadSeconds;
+
+    // Worked out lazily by getSampleMetadata, for the factory it was worked out for.
+    mutable std::shared_ptr<AudioFormatReaderFactory> metadataFactory;
+    mutable SampleMetadata metadata;
 
     ListenerList<Listener> listenerList;
 };
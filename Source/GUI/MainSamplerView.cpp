@@ -2,8 +2,11 @@
 
 #include "../DSP/AudioFormatReaderFactory.h"
 
-MainSamplerView::MainSamplerView (const DataModel& model, UndoManager& um)
+MainSamplerView::MainSamplerView (const DataModel& model, UndoManager& um,
+                                  std::function<const PlaybackSnapshot& ()> getPlaybackSnapshot,
+                                  std::function<std::shared_ptr<const PeakPyramid> ()> getPeakPyramid)
     : dataModel (model),
+    waveformView (model, std::move (getPlaybackSnapshot), std::move (getPeakPyramid)),
     undoManager (um)
 {
     dataModel.addListener (*this);
@@ -17,7 +20,7 @@ MainSamplerView::MainSamplerView (const DataModel& model, UndoManager& um)
             if (const auto result = fc.getResult (); result != File ())
             {
                 undoManager.beginNewTransaction ();
-                auto readerFactory = new FileAudioFormatReaderFactory (result);
+                auto readerFactory = new MemoryMappedAudioFormatReaderFactory (result);
                 dataModel.setSampleReader (std::unique_ptr<AudioFormatReaderFactory> (readerFactory), &undoManager);
             }
         };
@@ -46,6 +49,56 @@ MainSamplerView::MainSamplerView (const DataModel& model, UndoManager& um)
 
     addAndMakeVisible (centreFrequencyLabel);
 
+    addAndMakeVisible (interpolationMode);
+    interpolationMode.addItemList (getInterpolationModeNames (), 1);
+    interpolationMode.setSelectedItemIndex ((int) dataModel.getInterpolationMode (), dontSendNotification);
+    interpolationMode.onChange = [this]
+        {
+            undoManager.beginNewTransaction ();
+            dataModel.setInterpolationMode ((InterpolationMode) interpolationMode.getSelectedItemIndex (), &undoManager);
+        };
+
+    addAndMakeVisible (interpolationModeLabel);
+
+    addAndMakeVisible (renderThreads);
+
+    for (auto i = 0; i <= (int) ParallelVoiceRenderer::maxThreads; ++i)
+        renderThreads.addItem (i == 0 ? String ("Off") : String (i), i + 1);
+
+    renderThreads.setSelectedId (dataModel.getRenderThreads () + 1, dontSendNotification);
+    renderThreads.onChange = [this]
+        {
+            undoManager.beginNewTransaction ();
+            dataModel.setRenderThreads (renderThreads.getSelectedId () - 1, &undoManager);
+        };
+
+    addAndMakeVisible (renderThreadsLabel);
+
+    addAndMakeVisible (streamFromDisk);
+    streamFromDisk.setToggleState (dataModel.getStreamFromDisk (), dontSendNotification);
+    streamFromDisk.onClick = [this]
+        {
+            undoManager.beginNewTransaction ();
+            dataModel.setStreamFromDisk (streamFromDisk.getToggleState (), &undoManager);
+        };
+
+    addAndMakeVisible (streamPreload);
+
+    for (auto seconds : { 0.25, 0.5, 1.0, 2.0, 5.0 })
+        streamPreload.addItem (String (seconds) + " s", streamPreload.getNumItems () + 1);
+
+    streamPreloadSecondsChanged (dataModel.getStreamPreloadSeconds ());
+    streamPreload.setEnabled (dataModel.getStreamFromDisk ());
+    streamPreload.onChange = [this]
+        {
+            undoManager.beginNewTransaction ();
+            dataModel.setStreamPreloadSeconds (streamPreload.getText ().getDoubleValue (), &undoManager);
+        };
+
+    addAndMakeVisible (streamPreloadLabel);
+
+    addAndMakeVisible (waveformView);
+
     changeListenerCallback (&undoManager);
     undoManager.addChangeListener (this);
 }
@@ -70,4 +123,17 @@ void MainSamplerView::resized ()
     undoButton.setBounds (topBar.removeFromRight (100).reduced (padding));
     centreFrequencyLabel.setBounds (topBar.removeFromLeft (100).reduced (padding));
     centreFrequency.setBounds (topBar.removeFromLeft (100).reduced (padding));
+
+    auto settingsBar = bounds.removeFromTop (50);
+    interpolationModeLabel.setBounds (settingsBar.removeFromLeft (100).reduced (padding));
+    interpolationMode.setBounds (settingsBar.removeFromLeft (150).reduced (padding));
+    renderThreadsLabel.setBounds (settingsBar.removeFromLeft (140).reduced (padding));
+    renderThreads.setBounds (settingsBar.removeFromLeft (80).reduced (padding));
+
+    auto streamingBar = bounds.removeFromTop (50);
+    streamFromDisk.setBounds (streamingBar.removeFromLeft (250).reduced (padding));
+    streamPreloadLabel.setBounds (streamingBar.removeFromLeft (100).reduced (padding));
+    streamPreload.setBounds (streamingBar.removeFromLeft (100).reduced (padding));
+
+    waveformView.setBounds (bounds.reduced (padding));
 }
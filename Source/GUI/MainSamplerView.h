@@ -1,13 +1,16 @@
 #pragma once
 
 #include "../DataModel.h"
+#include "WaveformView.h"
 
 class MainSamplerView final : public Component,
                               private DataModel::Listener,
                               private ChangeListener
 {
 public:
-    MainSamplerView (const DataModel& model, UndoManager& um);
+    MainSamplerView (const DataModel& model, UndoManager& um,
+                     std::function<const PlaybackSnapshot& ()> getPlaybackSnapshot,
+                     std::function<std::shared_ptr<const PeakPyramid> ()> getPeakPyramid);
     ~MainSamplerView () override { undoManager.removeChangeListener (this); }
 
 private:
@@ -20,14 +23,43 @@ private:
         centreFrequency.setValue (value, dontSendNotification);
     }
 
+    void interpolationModeChanged (InterpolationMode value) override
+    {
+        interpolationMode.setSelectedItemIndex ((int) value, dontSendNotification);
+    }
+
+    void renderThreadsChanged (int value) override
+    {
+        renderThreads.setSelectedId (value + 1, dontSendNotification);
+    }
+
+    void streamFromDiskChanged (bool value) override
+    {
+        streamFromDisk.setToggleState (value, dontSendNotification);
+        streamPreload.setEnabled (value);
+    }
+
+    void streamPreloadSecondsChanged (double value) override
+    {
+        streamPreload.setText (String (value) + " s", dontSendNotification);
+    }
+
     DataModel dataModel;
 
     TextButton loadNewSampleButton { "Load New Sample" };
     TextButton undoButton { "Undo" };
     TextButton redoButton { "Redo" };
     Slider centreFrequency;
+    ComboBox interpolationMode;
+    ComboBox renderThreads;
+    ToggleButton streamFromDisk { "Stream long samples from disk" };
+    ComboBox streamPreload;
+    WaveformView waveformView;
 
     Label centreFrequencyLabel { {}, "Sample Centre Freq / Hz" };
+    Label interpolationModeLabel { {}, "Interpolation" };
+    Label renderThreadsLabel { {}, "Extra render threads" };
+    Label streamPreloadLabel { {}, "Preload" };
 
     FileChooser fileChooser { "Select a file to load...", File (),
                               dataModel.getAudioFormatManager ().getWildcardForAllFormats () };
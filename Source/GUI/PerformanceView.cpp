@@ -0,0 +1,197 @@
+#include "PerformanceView.h"
+#include "../SamplerAudioProcessor.h"
+#include "../Trace.h"
+
+namespace
+{
+String formatLoad (float load)
+{
+    return String (load * 100.0f, 1) + "%";
+}
+
+String formatMegabytes (int64 bytes)
+{
+    return String ((double) bytes / (1024.0 * 1024.0), 1) + " MB";
+}
+
+// The cache budgets on offer, in the order they appear in the combo box.
+constexpr int64 cacheBudgets[] { 0, (int64) 64 << 20, (int64) 256 << 20, (int64) 1 << 30 };
+} // namespace
+
+PerformanceView::PerformanceView (LoadMeter& meter, SamplePool& pool, const SampleStreamer& streamer,
+                                  std::function<const SynthStateSnapshot& ()> getSynthStateIn)
+    : loadMeter (meter),
+    getSynthState (std::move (getSynthStateIn)),
+    samplePool (pool),
+    sampleStreamer (streamer)
+{
+    addAndMakeVisible (cacheBudgetLabel);
+    addAndMakeVisible (cacheBudgetBox);
+    cacheBudgetBox.addItemList ({ "Off", "64 MB", "256 MB", "1 GB" }, 1);
+
+    const auto currentBudget = std::find (std::begin (cacheBudgets), std::end (cacheBudgets), samplePool.getCacheBudget ());
+
+    if (currentBudget != std::end (cacheBudgets))
+        cacheBudgetBox.setSelectedItemIndex ((int) std::distance (std::begin (cacheBudgets), currentBudget), dontSendNotification);
+    else
+        cacheBudgetBox.setText (formatMegabytes (samplePool.getCacheBudget ()), dontSendNotification);
+
+    cacheBudgetBox.onChange = [this]
+    {
+        const auto index = cacheBudgetBox.getSelectedItemIndex ();
+
+        if (isPositiveAndBelow (index, numElementsInArray (cacheBudgets)))
+            samplePool.setCacheBudget (cacheBudgets[index]);
+    };
+
+    addAndMakeVisible (resetButton);
+    resetButton.onClick = [this] { loadMeter.reset (); };
+
+    addChildComponent (saveTraceButton);
+    saveTraceButton.setVisible (Trace::isEnabled ());
+    saveTraceButton.onClick = [this] { saveTrace (); };
+
+    startTimerHz (10);
+}
+
+void PerformanceView::resized ()
+{
+    auto buttons = getLocalBounds ().reduced (8).removeFromTop (24);
+    resetButton.setBounds (buttons.removeFromRight (80));
+    saveTraceButton.setBounds (buttons.removeFromRight (110).withTrimmedRight (4));
+
+    cacheBudgetLabel.setBounds (buttons.removeFromLeft (100));
+    cacheBudgetBox.setBounds (buttons.removeFromLeft (100));
+}
+
+void PerformanceView::saveTrace ()
+{
+    const auto defaultFile = File::getSpecialLocation (File::userDesktopDirectory).getChildFile ("SamplerTrace.json");
+    traceChooser = std::make_unique<FileChooser> ("Save Trace", defaultFile, "*.json");
+
+    traceChooser->launchAsync (FileBrowserComponent::saveMode | FileBrowserComponent::canSelectFiles
+                                   | FileBrowserComponent::warnAboutOverwriting,
+                               [] (const FileChooser& chooser)
+                               {
+                                   const auto file = chooser.getResult ();
+
+                                   if (file == File ())
+                                       return;
+
+                                   Trace::writeToFileAsync (file, [file] (bool succeeded)
+                                   {
+                                       if (! succeeded)
+                                           AlertWindow::showMessageBoxAsync (MessageBoxIconType::WarningIcon, "Save Trace",
+                                                                             "Couldn't write " + file.getFullPathName ());
+                                   });
+                               });
+}
+
+void PerformanceView::timerCallback ()
+{
+    snapshot = loadMeter.getSnapshot ();
+    histogram = loadMeter.getHistogram ();
+    poolStatistics = samplePool.getStatistics ();
+    numStreamUnderruns = sampleStreamer.getNumUnderruns ();
+    numStreamsUnavailable = sampleStreamer.getNumStreamsUnavailable ();
+
+    if (getSynthState != nullptr)
+    {
+        const auto& synthState = getSynthState ();
+        appliedSettings = "Applied voices " + String (synthState.synthVoices)
+                        + "    " + (synthState.legacyModeEnabled ? "Legacy mode" : "MPE mode")
+                        + "    " + getInterpolationModeNames()[(int) synthState.interpolationMode]
+                        + "    Centre " + String (synthState.centreFrequencyHz, 1) + " Hz";
+    }
+
+    repaint ();
+}
+
+void PerformanceView::paint (Graphics& g)
+{
+    g.fillAll (findColour (ResizableWindow::backgroundColourId));
+
+    // Leave room for the controls along the top.
+    auto bounds = getLocalBounds ().reduced (8).withTrimmedTop (32);
+    const auto lineHeight = 22;
+
+    g.setColour (findColour (Label::textColourId));
+
+    const auto playing = snapshot.sampleRate > 0.0;
+    StringArray lines;
+
+    if (playing)
+    {
+        lines = StringArray {
+            "Load " + formatLoad (snapshot.currentLoad) + "    Peak " + formatLoad (snapshot.peakLoad),
+            "50th percentile " + formatLoad (LoadMeter::getPercentile (histogram, 50.0))
+                + "    90th " + formatLoad (LoadMeter::getPercentile (histogram, 90.0))
+                + "    99th " + formatLoad (LoadMeter::getPercentile (histogram, 99.0)),
+            "Commands " + formatLoad (snapshot.stageLoads[LoadMeter::commands])
+                + "    Rendering " + formatLoad (snapshot.stageLoads[LoadMeter::render])
+                + "    Telemetry " + formatLoad (snapshot.stageLoads[LoadMeter::telemetry]),
+            "Active voices " + String (snapshot.numActiveVoices),
+            "Budget " + String (snapshot.getBudgetMs (), 2) + " ms (" + String (snapshot.maximumBlockSize)
+                + " samples at " + String (snapshot.sampleRate, 0) + " Hz)",
+            "Overruns " + String ((int64) snapshot.numOverruns) + " of " + String ((int64) snapshot.numBlocks) + " blocks"
+        };
+    }
+    else
+    {
+        lines.add ("Not playing");
+    }
+
+    // What the audio thread is actually using, which can lag behind the editor.
+    if (appliedSettings.isNotEmpty ())
+        lines.add (appliedSettings);
+
+    // The pool is shared by every instance in the process.
+    lines.add ("Shared samples " + String (poolStatistics.numSamples) + " (" + formatMegabytes (poolStatistics.memoryUsageBytes)
+               + ")    Hits " + String (poolStatistics.hits) + "    Misses " + String (poolStatistics.misses));
+    lines.add ("Recently used " + String (poolStatistics.numCachedSamples) + " (" + formatMegabytes (poolStatistics.cachedBytes) + ")");
+
+    // Voices which went silent because the disk fell behind, and voices which
+    // stopped at the end of the head because every stream was busy.
+    lines.add ("Stream underruns " + String (numStreamUnderruns) + "    Voices without a stream " + String (numStreamsUnavailable));
+
+    for (const auto& line : lines)
+        g.drawText (line, bounds.removeFromTop (lineHeight), Justification::centredLeft);
+
+    if (playing)
+        drawHistogram (g, bounds.withTrimmedTop (8));
+}
+
+// One bar per bucket, scaled to the fullest bucket, with a line at 100%.
+void PerformanceView::drawHistogram (Graphics& g, Rectangle<int> area) const
+{
+    g.setColour (findColour (ResizableWindow::backgroundColourId).darker (0.2f));
+    g.fillRect (area);
+
+    const auto labels = area.removeFromBottom (16);
+    const auto maxCount = *std::max_element (histogram.begin (), histogram.end ());
+    const auto bucketWidth = (float) area.getWidth () / (float) LoadMeter::numBuckets;
+
+    if (maxCount > 0)
+    {
+        g.setColour (findColour (Slider::thumbColourId));
+
+        for (auto i = 0; i < (int) LoadMeter::numBuckets; ++i)
+        {
+            const auto height = (float) area.getHeight () * (float) histogram[(size_t) i] / (float) maxCount;
+            g.fillRect (Rectangle<float> ((float) area.getX () + (float) i * bucketWidth, (float) area.getBottom () - height,
+                                          jmax (1.0f, bucketWidth - 1.0f), height));
+        }
+    }
+
+    const auto budgetX = (float) area.getX () + 100.0f * bucketWidth;
+    g.setColour (Colours::red.withAlpha (0.7f));
+    g.drawVerticalLine (roundToInt (budgetX), (float) area.getY (), (float) area.getBottom ());
+
+    g.setColour (findColour (Label::textColourId));
+
+    for (auto percent : { 0, 50, 100, 150 })
+    {
+        const auto x = area.getX () + roundToInt ((float) percent * bucketWidth);
+        g.drawText (String (percent) + "%", x, labels.getY (), 50, labels.getHeight (), Justification::centredLeft);
+    }
+}
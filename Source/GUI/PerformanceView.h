@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../LoadMeter.h"
+#include "../DSP/SamplePool.h"
+#include "../DSP/SampleStreamer.h"
+
+struct SynthStateSnapshot;
+
+// Shows how much of the audio thread's time budget the processor is using:
+// the current and peak load, percentiles over every block since the last
+// reset, where the time goes, and a histogram of the load of each block. It
+// also shows the settings the audio thread has applied so far, and how much
+// memory the shared sample pool is using, and how often streaming voices have
+// gone short of data or of a stream. When tracing is compiled in, it can
+// also save the most recent trace events.
+class PerformanceView final : public Component,
+                              private Timer
+{
+public:
+    // getSynthState is called on the message thread, whenever the view updates.
+    PerformanceView (LoadMeter& meter, SamplePool& pool, const SampleStreamer& streamer,
+                     std::function<const SynthStateSnapshot& ()> getSynthState);
+
+    void paint (Graphics& g) override;
+    void resized () override;
+
+private:
+    void timerCallback () override;
+
+    void drawHistogram (Graphics& g, Rectangle<int> area) const;
+
+    void saveTrace ();
+
+    LoadMeter& loadMeter;
+    LoadMeter::Snapshot snapshot;
+    std::array<uint32, LoadMeter::numBuckets> histogram {};
+
+    std::function<const SynthStateSnapshot& ()> getSynthState;
+    String appliedSettings;
+
+    SamplePool& samplePool;
+    SamplePool::Statistics poolStatistics;
+
+    const SampleStreamer& sampleStreamer;
+    int numStreamUnderruns = 0, numStreamsUnavailable = 0;
+
+    // Sets the memory budget of the pool's cache, for every instance.
+    Label cacheBudgetLabel { {}, "Sample cache" };
+    ComboBox cacheBudgetBox;
+
+    TextButton resetButton { "Reset" };
+
+    // Only shown when tracing is compiled in.
+    TextButton saveTraceButton { "Save Trace..." };
+    std::unique_ptr<FileChooser> traceChooser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceView)
+};
@@ -4,7 +4,11 @@
 SamplerAudioProcessorEditor::SamplerAudioProcessorEditor (SamplerAudioProcessor& p, ProcessorState state)
     : AudioProcessorEditor (&p),
     samplerAudioProcessor (p),
-    mainSamplerView (dataModel, undoManager)
+    mainSamplerView (dataModel, undoManager,
+                     [this]() -> const PlaybackSnapshot& { return samplerAudioProcessor.getPlaybackSnapshot (); },
+                     [this] { return samplerAudioProcessor.getPeakPyramid (); }),
+    performanceView (p.getLoadMeter (), p.getSamplePool (), p.getSampleStreamer (),
+                     [this]() -> const SynthStateSnapshot& { return samplerAudioProcessor.getAppliedSynthState (); })
 {
     dataModel.addListener (*this);
     mpeSettings.addListener (*this);
@@ -18,6 +22,26 @@ SamplerAudioProcessorEditor::SamplerAudioProcessorEditor (SamplerAudioProcessor&
 
     tabbedComponent.addTab ("Sample Editor", bg, &mainSamplerView, false);
     tabbedComponent.addTab ("MPE Settings", bg, &settingsComponent, false);
+    tabbedComponent.addTab ("Performance", bg, &performanceView, false);
+
+    addChildComponent (loadProgressBar);
+    addChildComponent (cancelLoadButton);
+    cancelLoadButton.onClick = [this] { samplerAudioProcessor.cancelSampleLoading (); };
+
+    setState (std::move (state));
+
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setResizable (true, true);
+    setResizeLimits (640, 480, 2560, 1440);
+    setSize (640, 480);
+
+    startTimerHz (20);
+}
+
+void SamplerAudioProcessorEditor::setState (ProcessorState state)
+{
+    const ScopedValueSetter<bool> restoring (restoringState, true);
 
     mpeSettings.setSynthVoices (state.synthVoices, nullptr);
     mpeSettings.setLegacyModeEnabled (state.legacyModeEnabled, nullptr);
@@ -27,21 +51,50 @@ SamplerAudioProcessorEditor::SamplerAudioProcessorEditor (SamplerAudioProcessor&
     mpeSettings.setVoiceStealingEnabled (state.voiceStealingEnabled, nullptr);
     mpeSettings.setMPEZoneLayout (state.mpeZoneLayout, nullptr);
 
+    // The streaming options must be in place before the sample is loaded.
+    samplerAudioProcessor.setStreamingOptions (state.streamFromDisk, state.streamPreloadSeconds);
+    dataModel.setStreamFromDisk (state.streamFromDisk, nullptr);
+    dataModel.setStreamPreloadSeconds (state.streamPreloadSeconds, nullptr);
+
     dataModel.setSampleReader (std::move (state.readerFactory), nullptr);
 
     dataModel.setCentreFrequencyHz (state.centreFrequencyHz, nullptr);
+    dataModel.setInterpolationMode (state.interpolationMode, nullptr);
+    dataModel.setRenderThreads (state.renderThreads, nullptr);
 
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setResizable (true, true);
-    setResizeLimits (640, 480, 2560, 1440);
-    setSize (640, 480);
+    undoManager.clearUndoHistory ();
+}
+
+void SamplerAudioProcessorEditor::resized ()
+{
+    auto bounds = getLocalBounds ();
+
+    if (loadProgressBar.isVisible ())
+    {
+        auto loadBar = bounds.removeFromBottom (30).reduced (4);
+        cancelLoadButton.setBounds (loadBar.removeFromRight (80));
+        loadProgressBar.setBounds (loadBar.withTrimmedRight (4));
+    }
+
+    tabbedComponent.setBounds (bounds);
+}
+
+void SamplerAudioProcessorEditor::timerCallback ()
+{
+    const auto loading = samplerAudioProcessor.isLoadingSample ();
+    loadProgress = samplerAudioProcessor.getSampleLoadProgress ();
+
+    if (loading != loadProgressBar.isVisible ())
+    {
+        loadProgressBar.setVisible (loading);
+        cancelLoadButton.setVisible (loading);
+        resized ();
+    }
 }
 
 void SamplerAudioProcessorEditor::sampleReaderChanged (std::shared_ptr<AudioFormatReaderFactory> value)
 {
-    samplerAudioProcessor.setSample (value == nullptr ? nullptr : value->clone (),
-                                     dataModel.getAudioFormatManager ());
+    samplerAudioProcessor.setSample (value == nullptr ? nullptr : value->clone ());
 }
 
 void SamplerAudioProcessorEditor::centreFrequencyHzChanged (double value)
@@ -49,6 +102,42 @@ void SamplerAudioProcessorEditor::centreFrequencyHzChanged (double value)
     samplerAudioProcessor.setCentreFrequency (value);
 }
 
+void SamplerAudioProcessorEditor::interpolationModeChanged (InterpolationMode value)
+{
+    samplerAudioProcessor.setInterpolationMode (value);
+}
+
+void SamplerAudioProcessorEditor::renderThreadsChanged (int value)
+{
+    samplerAudioProcessor.setNumRenderThreads (value);
+}
+
+void SamplerAudioProcessorEditor::streamFromDiskChanged (bool value)
+{
+    samplerAudioProcessor.setStreamingOptions (value, dataModel.getStreamPreloadSeconds ());
+    reloadSample ();
+}
+
+void SamplerAudioProcessorEditor::streamPreloadSecondsChanged (double value)
+{
+    samplerAudioProcessor.setStreamingOptions (dataModel.getStreamFromDisk (), value);
+    reloadSample ();
+}
+
+void SamplerAudioProcessorEditor::reloadSample ()
+{
+    // The streaming options are set before the sample, so reloading here would
+    // load the sample we're about to replace, and would drop any zones.
+    if (restoringState)
+        return;
+
+    // The model only knows about single samples, so it can't see the zones.
+    if (samplerAudioProcessor.hasZones ())
+        samplerAudioProcessor.reloadZones ();
+    else if (auto factory = dataModel.getSampleReaderFactory ())
+        samplerAudioProcessor.setSample (factory->clone ());
+}
+
 void SamplerAudioProcessorEditor::synthVoicesChanged (int value)
 {
     samplerAudioProcessor.setNumberOfVoices (value);
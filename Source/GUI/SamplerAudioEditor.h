@@ -3,23 +3,28 @@
 #include "../DataModel.h"
 #include "MainSamplerView.h"
 #include "MpeSettingsComponent.h"
+#include "PerformanceView.h"
 
 class SamplerAudioProcessor;
 struct ProcessorState;
 
 class SamplerAudioProcessorEditor final : public AudioProcessorEditor,
     public FileDragAndDropTarget,
+    private Timer,
     private DataModel::Listener,
     private MPESettingsDataModel::Listener
 {
 public:
     SamplerAudioProcessorEditor (SamplerAudioProcessor& p, ProcessorState state);
 
+    // Brings the editor up to date with a state, clearing the undo history.
+    void setState (ProcessorState state);
+
 private:
-    void resized () override
-    {
-        tabbedComponent.setBounds (getLocalBounds ());
-    }
+    void resized () override;
+
+    // Shows the progress bar while a sample is loading.
+    void timerCallback () override;
 
     bool keyPressed (const KeyPress& key) override
     {
@@ -48,7 +53,7 @@ private:
     {
         jassert (files.size () == 1);
         undoManager.beginNewTransaction ();
-        auto r = new FileAudioFormatReaderFactory (files[0]);
+        auto r = new MemoryMappedAudioFormatReaderFactory (files[0]);
         dataModel.setSampleReader (std::unique_ptr<AudioFormatReaderFactory> (r), &undoManager);
     }
 
@@ -56,6 +61,18 @@ private:
 
     void centreFrequencyHzChanged (double value) override;
 
+    void interpolationModeChanged (InterpolationMode value) override;
+
+    void renderThreadsChanged (int value) override;
+
+    void streamFromDiskChanged (bool value) override;
+
+    void streamPreloadSecondsChanged (double value) override;
+
+    // Reloads the current sample, or the processor's zones, so that new
+    // streaming options take effect.
+    void reloadSample ();
+
     void synthVoicesChanged (int value) override;
 
     void voiceStealingEnabledChanged (bool value) override;
@@ -83,9 +100,11 @@ private:
         setProcessorLegacyMode ();
     }
 
-    void legacyPitchbendRangeChanged (int) override
+    void legacyPitchbendRangeChanged (int value) override
     {
-        setProcessorLegacyMode ();
+        // Changing just the range doesn't need to go through the command queue.
+        if (mpeSettings.getLegacyModeEnabled ())
+            samplerAudioProcessor.setLegacyPitchbendRange (value);
     }
 
     void setProcessorLegacyMode ();
@@ -101,6 +120,15 @@ private:
     TabbedComponent tabbedComponent { TabbedButtonBar::Orientation::TabsAtTop };
     MPESettingsComponent settingsComponent { dataModel.mpeSettings (), undoManager };
     MainSamplerView mainSamplerView;
+    PerformanceView performanceView;
+
+    // True while setState is bringing the model up to date. The processor
+    // already has the state, so there's nothing to reload.
+    bool restoringState = false;
+
+    double loadProgress = -1.0;
+    ProgressBar loadProgressBar { loadProgress };
+    TextButton cancelLoadButton { "Cancel" };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SamplerAudioProcessorEditor)
 };
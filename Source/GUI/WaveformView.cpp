@@ -0,0 +1,222 @@
+#include "WaveformView.h"
+#include "../SamplerAudioProcessor.h"
+
+WaveformView::WaveformView (const DataModel& model,
+                            std::function<const PlaybackSnapshot& ()> getSnapshot,
+                            std::function<std::shared_ptr<const PeakPyramid> ()> getPyramid)
+    : dataModel (model),
+    getPlaybackSnapshot (std::move (getSnapshot)),
+    getPeakPyramid (std::move (getPyramid))
+{
+    cursorPositions.reserve (PlaybackSnapshot::maxVoices);
+    dataModel.addListener (*this);
+
+    if (getPeakPyramid != nullptr)
+        setPyramid (getPeakPyramid ());
+
+    startTimerHz (60);
+}
+
+WaveformView::~WaveformView ()
+{
+    dataModel.removeListener (*this);
+}
+
+void WaveformView::setPyramid (std::shared_ptr<const PeakPyramid> newPyramid)
+{
+    pyramid = std::move (newPyramid);
+
+    // Show the whole sample to begin with.
+    const auto numFrames = pyramid != nullptr ? (double) pyramid->getNumFrames () : 0.0;
+    setVisibleRange (0.0, numFrames / jmax (1, getWidth ()));
+}
+
+void WaveformView::setVisibleRange (double start, double framesPerPixel)
+{
+    const auto width = (double) jmax (1, getWidth ());
+    const auto numFrames = pyramid != nullptr ? (double) pyramid->getNumFrames () : 0.0;
+
+    visibleFramesPerPixel = jlimit ((double) PeakPyramid::baseBucketSize,
+                                    jmax ((double) PeakPyramid::baseBucketSize, numFrames / width),
+                                    framesPerPixel);
+
+    visibleStart = jlimit (0.0, jmax (0.0, numFrames - visibleFramesPerPixel * width), start);
+
+    drawWaveform ();
+    repaint ();
+}
+
+void WaveformView::resized ()
+{
+    setVisibleRange (visibleStart, visibleFramesPerPixel);
+}
+
+//==============================================================================
+
+void WaveformView::drawWaveform ()
+{
+    if (getWidth () <= 0 || getHeight () <= 0)
+    {
+        waveform = {};
+        return;
+    }
+
+    waveform = Image (Image::ARGB, getWidth (), getHeight (), true);
+
+    if (pyramid == nullptr)
+        return;
+
+    Graphics g (waveform);
+
+    const auto colour = findColour (Slider::thumbColourId);
+    const auto centre = (float) getHeight () * 0.5f;
+    const auto halfHeight = (float) getHeight () * 0.45f;
+
+    // Every pixel costs a couple of bucket lookups, however far we're zoomed out.
+    for (auto x = 0; x < getWidth (); ++x)
+    {
+        const auto start = (int64) (visibleStart + x * visibleFramesPerPixel);
+        const auto end = (int64) (visibleStart + (x + 1) * visibleFramesPerPixel);
+
+        if (start >= pyramid->getNumFrames ())
+            break;
+
+        const auto peak = pyramid->getPeak (start, end);
+        const auto rms = peak.getRms ();
+
+        g.setColour (colour.withAlpha (0.5f));
+        g.drawVerticalLine (x, centre - peak.max * halfHeight, centre - peak.min * halfHeight + 1.0f);
+
+        g.setColour (colour);
+        g.drawVerticalLine (x, centre - rms * halfHeight, centre + rms * halfHeight + 1.0f);
+    }
+}
+
+void WaveformView::paint (Graphics& g)
+{
+    g.fillAll (findColour (ResizableWindow::backgroundColourId).darker (0.2f));
+
+    if (pyramid == nullptr)
+    {
+        drawEmptyState (g);
+        return;
+    }
+
+    g.drawImageAt (waveform, 0, 0);
+
+    g.setColour (findColour (Label::textColourId));
+    g.setFont (12.0f);
+    g.drawText (getDescription (), getLocalBounds ().reduced (4).removeFromTop (16), Justification::topLeft);
+
+    g.setColour (findColour (Slider::trackColourId).brighter ());
+
+    for (auto frame : cursorPositions)
+    {
+        const auto x = (float) frameToX (frame);
+
+        if (x >= 0.0f && x < (float) getWidth ())
+            g.drawVerticalLine (roundToInt (x), 0.0f, (float) getHeight ());
+    }
+}
+
+void WaveformView::drawEmptyState (Graphics& g) const
+{
+    // A new instance starts without a sample, so this is the first thing most
+    // people see. It has to say why nothing plays, and what to do about it.
+    String heading, detail;
+
+    if (dataModel.getSampleReaderFactory () == nullptr)
+    {
+        heading = "No sample loaded";
+        detail = "Click \"Load New Sample\", or drop an audio file here.";
+    }
+    else if (! dataModel.getSampleMetadata ().isValid ())
+    {
+        heading = "The sample couldn't be read";
+        detail = "Try another file.";
+    }
+    else
+    {
+        // Either the sample is loading, or it's playing and its waveform
+        // hasn't been summarised yet.
+        heading = "Reading sample...";
+    }
+
+    auto area = getLocalBounds ().withSizeKeepingCentre (getWidth (), 48);
+
+    g.setColour (findColour (Label::textColourId));
+    g.setFont (18.0f);
+    g.drawText (heading, area.removeFromTop (26), Justification::centred);
+
+    g.setColour (findColour (Label::textColourId).withAlpha (0.7f));
+    g.setFont (14.0f);
+    g.drawText (detail, area, Justification::centred);
+}
+
+String WaveformView::getDescription () const
+{
+    const auto& metadata = dataModel.getSampleMetadata ();
+    String description;
+
+    if (metadata.isValid ())
+        description << String (metadata.getLengthSeconds (), 2) << " s    "
+                    << String (metadata.sampleRate, 0) << " Hz    "
+                    << metadata.numChannels << (metadata.numChannels == 1 ? " channel    " : " channels    ")
+                    << metadata.bitsPerSample << "-bit    ";
+
+    if (pyramid != nullptr)
+        description << "Peak " << Decibels::toString (Decibels::gainToDecibels (pyramid->getPeakLevel ()));
+
+    return description;
+}
+
+void WaveformView::timerCallback ()
+{
+    // A new sample has finished loading.
+    if (getPeakPyramid != nullptr)
+        if (auto latest = getPeakPyramid (); latest != pyramid)
+            setPyramid (std::move (latest));
+
+    if (pyramid == nullptr || getPlaybackSnapshot == nullptr)
+        return;
+
+    const auto& snapshot = getPlaybackSnapshot ();
+
+    if (snapshot.numActiveVoices == 0 && cursorPositions.empty ())
+        return;
+
+    cursorPositions.clear ();
+
+    for (auto i = 0; i < snapshot.numActiveVoices; ++i)
+        cursorPositions.push_back ((float) (snapshot.positionsInSeconds[(size_t) i] * pyramid->getSampleRate ()));
+
+    repaint ();
+}
+
+//==============================================================================
+
+void WaveformView::mouseDown (const MouseEvent&)
+{
+    dragStartVisibleStart = visibleStart;
+}
+
+void WaveformView::mouseDrag (const MouseEvent& e)
+{
+    setVisibleRange (dragStartVisibleStart - e.getDistanceFromDragStartX () * visibleFramesPerPixel,
+                     visibleFramesPerPixel);
+}
+
+void WaveformView::mouseDoubleClick (const MouseEvent&)
+{
+    if (pyramid != nullptr)
+        setVisibleRange (0.0, (double) pyramid->getNumFrames () / jmax (1, getWidth ()));
+}
+
+void WaveformView::mouseWheelMove (const MouseEvent& e, const MouseWheelDetails& wheel)
+{
+    // Zoom around the frame under the mouse, so that it stays put.
+    const auto anchor = visibleStart + e.position.x * visibleFramesPerPixel;
+    const auto framesPerPixel = visibleFramesPerPixel * std::pow (2.0, -wheel.deltaY * 4.0);
+
+    setVisibleRange (anchor - e.position.x * framesPerPixel, framesPerPixel);
+}
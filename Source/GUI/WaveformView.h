@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../DataModel.h"
+#include "../DSP/PeakPyramid.h"
+
+struct PlaybackSnapshot;
+
+// Draws the waveform of the sample that's playing, along with a cursor for
+// every voice that's playing it, and a line describing the sample. Without a
+// sample, it says so, and how to load one.
+//
+// The waveform is drawn from the sample's PeakPyramid, which the processor
+// builds in the background once the sample is playing, so drawing never
+// touches the audio itself, and opening an editor doesn't read anything. It's drawn
+// into an image which is only redrawn when the view moves, so the cursors can
+// be updated at 60Hz for next to nothing.
+//
+// Scroll to zoom in and out around the mouse, drag to scroll sideways, and
+// double-click to see the whole sample again.
+class WaveformView final : public Component,
+                           private DataModel::Listener,
+                           private Timer
+{
+public:
+    // Both functions are called on the message thread, at up to 60Hz.
+    WaveformView (const DataModel& model,
+                  std::function<const PlaybackSnapshot& ()> getPlaybackSnapshot,
+                  std::function<std::shared_ptr<const PeakPyramid> ()> getPeakPyramid);
+    ~WaveformView () override;
+
+    void paint (Graphics& g) override;
+    void resized () override;
+
+    void mouseDown (const MouseEvent& e) override;
+    void mouseDrag (const MouseEvent& e) override;
+    void mouseDoubleClick (const MouseEvent& e) override;
+    void mouseWheelMove (const MouseEvent& e, const MouseWheelDetails& wheel) override;
+
+private:
+    void sampleReaderChanged (std::shared_ptr<AudioFormatReaderFactory>) override { repaint (); }
+    void timerCallback () override;
+
+    // Says that there's no sample, or that it's on its way, and how to load one.
+    void drawEmptyState (Graphics& g) const;
+
+    // The sample's format and length, from the data model's cached metadata,
+    // and its peak level, from the pyramid.
+    String getDescription () const;
+
+    void setPyramid (std::shared_ptr<const PeakPyramid> newPyramid);
+
+    // Keeps the visible range inside the sample, and no narrower than one
+    // level-0 bucket per pixel.
+    void setVisibleRange (double start, double framesPerPixel);
+
+    void drawWaveform ();
+
+    double frameToX (double frame) const { return (frame - visibleStart) / visibleFramesPerPixel; }
+
+    DataModel dataModel;
+    std::function<const PlaybackSnapshot& ()> getPlaybackSnapshot;
+    std::function<std::shared_ptr<const PeakPyramid> ()> getPeakPyramid;
+
+    std::shared_ptr<const PeakPyramid> pyramid;
+    Image waveform;
+
+    double visibleStart = 0.0;
+    double visibleFramesPerPixel = 1.0;
+    double dragStartVisibleStart = 0.0;
+
+    std::vector<float> cursorPositions;
+};
@@ -12,6 +12,10 @@ namespace IDs
 DECLARE_ID (DATA_MODEL)
 DECLARE_ID (sampleReader)
 DECLARE_ID (centreFrequencyHz)
+DECLARE_ID (interpolationMode)
+DECLARE_ID (renderThreads)
+DECLARE_ID (streamFromDisk)
+DECLARE_ID (streamPreloadSeconds)
 
 DECLARE_ID (MPE_SETTINGS)
 DECLARE_ID (synthVoices)
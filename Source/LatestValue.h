@@ -0,0 +1,53 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+// Hands the most recent value of a setting from the message thread to the audio
+// thread, without queueing. However often the value is set, the audio thread
+// only sees (and acts on) the latest one, once per block.
+//
+// The value is held in a lock-free atomic, so both sides are wait-free. There
+// should only be one reading thread.
+template <typename Value>
+class LatestValue final
+{
+public:
+    static_assert (std::atomic<Value>::is_always_lock_free, "LatestValue needs a lock-free atomic");
+
+    explicit LatestValue (Value initial) noexcept
+        : value (initial)
+    {
+    }
+
+    // Any thread.
+    void set (Value newValue) noexcept
+    {
+        value.store (newValue, std::memory_order_relaxed);
+        changed.store (true, std::memory_order_release);
+    }
+
+    // Any thread. The most recently set value, whether or not the reader has
+    // picked it up yet.
+    Value get () const noexcept
+    {
+        return value.load (std::memory_order_relaxed);
+    }
+
+    // Reader only. If the value has been set since the last call, stores it in
+    // 'result' and returns true.
+    bool takeIfChanged (Value& result) noexcept
+    {
+        if (! changed.exchange (false, std::memory_order_acquire))
+            return false;
+
+        result = value.load (std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<Value> value;
+    std::atomic<bool> changed { false };
+
+    JUCE_DECLARE_NON_COPYABLE (LatestValue)
+};
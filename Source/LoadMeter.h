@@ -0,0 +1,194 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+#include "TripleBuffer.h"
+
+// Measures how much of each block's time budget the audio callback uses, where
+// the budget is the length of the block in real time. A load of 1.0 means the
+// callback took as long as the audio it produced, and the host is about to
+// drop out.
+//
+// The audio thread times each stage of the callback, adds the block's load to a
+// histogram, and publishes a snapshot. Nothing on either side ever waits: the
+// histogram's buckets are atomics with a single writer, and the snapshot goes
+// through a TripleBuffer.
+class LoadMeter final
+{
+public:
+    enum Stage
+    {
+        commands = 0,   // Applying commands and settings from the message thread.
+        render,         // synthesiser.renderNextBlock.
+        telemetry,      // Publishing playback positions for the editor.
+        numStages
+    };
+
+    // Each bucket covers 1% of the budget. The last one also counts every block
+    // which took more than twice its budget.
+    enum { numBuckets = 200 };
+
+    struct Snapshot
+    {
+        double sampleRate = 0.0;
+        int maximumBlockSize = 0;
+
+        // The load, averaged over the last few hundred milliseconds.
+        float currentLoad = 0.0f;
+        std::array<float, numStages> stageLoads {};
+
+        // Since the last reset.
+        float peakLoad = 0.0f;
+        uint64 numBlocks = 0;
+        uint64 numOverruns = 0;
+
+        int numActiveVoices = 0;
+
+        double getBudgetMs () const
+        {
+            return sampleRate > 0.0 ? 1000.0 * maximumBlockSize / sampleRate : 0.0;
+        }
+    };
+
+    // Call from prepareToPlay, while the audio thread isn't running.
+    void prepare (double newSampleRate, int newMaximumBlockSize) noexcept
+    {
+        sampleRate = newSampleRate;
+        maximumBlockSize = newMaximumBlockSize;
+        smoothedLoads = {};
+        resetRequested = true;
+    }
+
+    //==============================================================================
+    // Audio thread only.
+    void beginBlock () noexcept
+    {
+        stageStart = Time::getHighResolutionTicks ();
+    }
+
+    void endStage (Stage stage) noexcept
+    {
+        const auto now = Time::getHighResolutionTicks ();
+        stageTicks[(size_t) stage] = now - stageStart;
+        stageStart = now;
+    }
+
+    // Ends the telemetry stage, and with it the block.
+    void endBlock (int numSamples, int numActiveVoices) noexcept
+    {
+        endStage (telemetry);
+
+        if (resetRequested.exchange (false, std::memory_order_acquire))
+        {
+            for (auto& bucket : histogram)
+                bucket.store (0, std::memory_order_relaxed);
+
+            peakLoad = 0.0f;
+            numBlocks = 0;
+            numOverruns = 0;
+        }
+
+        if (sampleRate <= 0.0 || numSamples <= 0)
+            return;
+
+        const auto blockSeconds = numSamples / sampleRate;
+        const auto toLoad = [blockSeconds] (int64 ticks) { return (float) (Time::highResolutionTicksToSeconds (ticks) / blockSeconds); };
+
+        // A one-pole average with a time constant of about 300ms, whatever the
+        // block size.
+        const auto smoothing = (float) std::exp (-blockSeconds / 0.3);
+        auto load = 0.0f;
+
+        for (size_t i = 0; i < (size_t) numStages; ++i)
+        {
+            const auto stageLoad = toLoad (stageTicks[i]);
+            smoothedLoads[i] = stageLoad + smoothing * (smoothedLoads[i] - stageLoad);
+            load += stageLoad;
+        }
+
+        auto& bucket = histogram[(size_t) jlimit (0, (int) numBuckets - 1, (int) (load * 100.0f))];
+        bucket.store (bucket.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        peakLoad = jmax (peakLoad, load);
+        ++numBlocks;
+
+        if (load > 1.0f)
+            ++numOverruns;
+
+        auto& snapshot = snapshots.getWriteBuffer ();
+        snapshot.sampleRate = sampleRate;
+        snapshot.maximumBlockSize = maximumBlockSize;
+        snapshot.stageLoads = smoothedLoads;
+        snapshot.currentLoad = std::accumulate (smoothedLoads.begin (), smoothedLoads.end (), 0.0f);
+        snapshot.peakLoad = peakLoad;
+        snapshot.numBlocks = numBlocks;
+        snapshot.numOverruns = numOverruns;
+        snapshot.numActiveVoices = numActiveVoices;
+        snapshots.publish ();
+    }
+
+    //==============================================================================
+    // Message thread only.
+    const Snapshot& getSnapshot () noexcept
+    {
+        snapshots.update ();
+        return snapshots.getReadBuffer ();
+    }
+
+    // Copies the histogram. The audio thread may be adding to it as we read, so
+    // the buckets might not all be from exactly the same block.
+    std::array<uint32, numBuckets> getHistogram () const noexcept
+    {
+        std::array<uint32, numBuckets> counts;
+
+        for (size_t i = 0; i < (size_t) numBuckets; ++i)
+            counts[i] = histogram[i].load (std::memory_order_relaxed);
+
+        return counts;
+    }
+
+    // Returns the load that the given percentage of blocks came in under, to
+    // the nearest bucket.
+    static float getPercentile (const std::array<uint32, numBuckets>& counts, double percentile) noexcept
+    {
+        const auto total = std::accumulate (counts.begin (), counts.end (), (uint64) 0);
+
+        if (total == 0)
+            return 0.0f;
+
+        const auto wanted = (uint64) std::ceil (percentile / 100.0 * (double) total);
+        uint64 seen = 0;
+
+        for (size_t i = 0; i < (size_t) numBuckets; ++i)
+        {
+            seen += counts[i];
+
+            if (seen >= wanted)
+                return (float) (i + 1) / 100.0f;
+        }
+
+        return (float) numBuckets / 100.0f;
+    }
+
+    // Clears the peak and the histogram, from the start of the next block.
+    void reset () noexcept { resetRequested.store (true, std::memory_order_release); }
+
+private:
+    // Written in prepare, then only read by the audio thread.
+    double sampleRate = 0.0;
+    int maximumBlockSize = 0;
+
+    // Audio thread only.
+    int64 stageStart = 0;
+    std::array<int64, numStages> stageTicks {};
+    std::array<float, numStages> smoothedLoads {};
+    float peakLoad = 0.0f;
+    uint64 numBlocks = 0, numOverruns = 0;
+
+    std::array<std::atomic<uint32>, numBuckets> histogram {};
+    std::atomic<bool> resetRequested { false };
+    TripleBuffer<Snapshot> snapshots;
+
+    JUCE_DECLARE_NON_COPYABLE (LoadMeter)
+};
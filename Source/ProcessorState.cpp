@@ -0,0 +1,234 @@
+#include "ProcessorState.h"
+#include "DSP/ParallelVoiceRenderer.h"
+
+namespace
+{
+// "SMPS", followed by the format version. Bump the version whenever fields are
+// added, and only ever add them to the end.
+constexpr int magic = 0x53504d53;
+constexpr int currentVersion = 2;
+
+enum SampleFlags
+{
+    hasFile = 1 << 0,
+    hasEmbeddedData = 1 << 1
+};
+
+template <typename Zone>
+void writeZone (const Zone& zone, OutputStream& out)
+{
+    out.writeInt (zone.numMemberChannels);
+    out.writeInt (zone.perNotePitchbendRange);
+    out.writeInt (zone.masterPitchbendRange);
+}
+
+struct ZoneSettings
+{
+    int numMemberChannels = 0;
+    int perNotePitchbendRange = 48;
+    int masterPitchbendRange = 2;
+};
+
+ZoneSettings readZone (InputStream& in)
+{
+    ZoneSettings zone;
+    zone.numMemberChannels = jlimit (0, 15, in.readInt ());
+    zone.perNotePitchbendRange = jlimit (0, 96, in.readInt ());
+    zone.masterPitchbendRange = jlimit (0, 96, in.readInt ());
+    return zone;
+}
+
+void writeSample (const AudioFormatReaderFactory* factory, OutputStream& out)
+{
+    const auto file = factory != nullptr ? factory->getFile () : File ();
+    const auto* shared = dynamic_cast<const SharedMemoryAudioFormatReaderFactory*> (factory);
+
+    MemoryBlock embedded;
+
+    if (shared != nullptr)
+        embedded = shared->getData ();
+    else if (file.existsAsFile () && file.getSize () <= ProcessorStateFormat::maxEmbeddedSampleBytes)
+        file.loadFileAsData (embedded);
+
+    out.writeByte ((char) ((file != File () ? hasFile : 0) | (embedded.getSize () > 0 ? hasEmbeddedData : 0)));
+
+    if (file != File ())
+    {
+        out.writeString (file.getFullPathName ());
+        out.writeInt64 ((int64) getFileFingerprint (file));
+    }
+
+    if (embedded.getSize () > 0)
+    {
+        out.writeInt64 ((int64) embedded.getSize ());
+        out.write (embedded.getData (), embedded.getSize ());
+    }
+}
+
+// Returns false if the data is malformed, in which case nothing after it can be
+// read either. Otherwise 'result' is the sample's factory, or nullptr if the
+// sample can no longer be found.
+bool readSample (InputStream& in, std::unique_ptr<AudioFormatReaderFactory>& result)
+{
+    const auto flags = (int) (uint8) in.readByte ();
+    File file;
+    uint64 fingerprint = 0;
+
+    if ((flags & hasFile) != 0)
+    {
+        const auto path = in.readString ();
+        fingerprint = (uint64) in.readInt64 ();
+
+        if (File::isAbsolutePath (path))
+            file = File (path);
+    }
+
+    std::shared_ptr<MemoryBlock> embedded;
+
+    if ((flags & hasEmbeddedData) != 0)
+    {
+        const auto size = in.readInt64 ();
+
+        if (size <= 0 || size > in.getNumBytesRemaining ())
+            return false;
+
+        embedded = std::make_shared<MemoryBlock> ();
+        in.readIntoMemoryBlock (*embedded, (ssize_t) size);
+    }
+
+    // Prefer the file, as long as it's still the one we saved. Otherwise fall
+    // back to the embedded copy, and failing that, to whatever the file is now.
+    const auto fileExists = file.existsAsFile ();
+
+    if (fileExists && getFileFingerprint (file) == fingerprint)
+        result = std::make_unique<MemoryMappedAudioFormatReaderFactory> (file);
+    else if (embedded != nullptr)
+        result = std::make_unique<SharedMemoryAudioFormatReaderFactory> (std::move (embedded));
+    else if (fileExists)
+        result = std::make_unique<MemoryMappedAudioFormatReaderFactory> (file);
+    else
+        result = nullptr;
+
+    return true;
+}
+} // namespace
+
+void ProcessorStateFormat::write (const ProcessorState& state, OutputStream& stream)
+{
+    // The body is written first, so that its length can go in the header.
+    MemoryOutputStream out;
+
+    out.writeDouble (state.centreFrequencyHz);
+    out.writeInt ((int) state.interpolationMode);
+    out.writeInt (state.renderThreads);
+    out.writeBool (state.streamFromDisk);
+    out.writeDouble (state.streamPreloadSeconds);
+
+    out.writeInt (state.synthVoices);
+    out.writeBool (state.voiceStealingEnabled);
+    out.writeBool (state.legacyModeEnabled);
+    out.writeInt (state.legacyChannels.getStart ());
+    out.writeInt (state.legacyChannels.getEnd ());
+    out.writeInt (state.legacyPitchbendRange);
+
+    writeZone (state.mpeZoneLayout.getLowerZone (), out);
+    writeZone (state.mpeZoneLayout.getUpperZone (), out);
+
+    writeSample (state.readerFactory.get (), out);
+
+    // Version 2 onwards.
+    out.writeInt ((int) state.zones.size ());
+
+    for (const auto& zone : state.zones)
+    {
+        out.writeInt (zone.rootNote);
+        out.writeInt (zone.keys.getStart ());
+        out.writeInt (zone.keys.getEnd ());
+        out.writeInt (zone.velocities.getStart ());
+        out.writeInt (zone.velocities.getEnd ());
+        writeSample (zone.readerFactory.get (), out);
+    }
+
+    stream.writeInt (magic);
+    stream.writeInt (currentVersion);
+    stream.writeInt64 ((int64) out.getDataSize ());
+    stream.write (out.getData (), out.getDataSize ());
+}
+
+bool ProcessorStateFormat::read (InputStream& in, ProcessorState& state)
+{
+    if (in.readInt () != magic)
+        return false;
+
+    const auto version = in.readInt ();
+
+    if (version < 1 || version > currentVersion)
+        return false;
+
+    // Refuse truncated states up front, rather than reading zeros off the end.
+    const auto bodySize = in.readInt64 ();
+
+    if (bodySize <= 0 || bodySize > in.getNumBytesRemaining ())
+        return false;
+
+    ProcessorState result;
+
+    result.centreFrequencyHz = jlimit (20.0, 20000.0, in.readDouble ());
+    result.interpolationMode = (InterpolationMode) jlimit ((int) InterpolationMode::linear,
+                                                           (int) InterpolationMode::sinc32,
+                                                           in.readInt ());
+    result.renderThreads = jlimit (0, (int) ParallelVoiceRenderer::maxThreads, in.readInt ());
+    result.streamFromDisk = in.readBool ();
+    result.streamPreloadSeconds = jlimit (0.25, 10.0, in.readDouble ());
+
+    result.synthVoices = jlimit (1, 200, in.readInt ());
+    result.voiceStealingEnabled = in.readBool ();
+    result.legacyModeEnabled = in.readBool ();
+
+    const auto firstChannel = jlimit (1, 16, in.readInt ());
+    const auto lastChannel = jlimit (firstChannel, 16, in.readInt ());
+    result.legacyChannels = { firstChannel, lastChannel };
+    result.legacyPitchbendRange = jlimit (0, 95, in.readInt ());
+
+    const auto lower = readZone (in);
+    const auto upper = readZone (in);
+
+    if (lower.numMemberChannels > 0)
+        result.mpeZoneLayout.setLowerZone (lower.numMemberChannels, lower.perNotePitchbendRange, lower.masterPitchbendRange);
+
+    if (upper.numMemberChannels > 0)
+        result.mpeZoneLayout.setUpperZone (upper.numMemberChannels, upper.perNotePitchbendRange, upper.masterPitchbendRange);
+
+    if (! readSample (in, result.readerFactory))
+        return false;
+
+    if (version >= 2)
+    {
+        const auto numZones = in.readInt ();
+
+        if (numZones < 0 || numZones > ProcessorStateFormat::maxZones)
+            return false;
+
+        for (auto i = 0; i < numZones; ++i)
+        {
+            SampleZoneSource zone;
+            zone.rootNote = jlimit (-1, 127, in.readInt ());
+
+            const auto firstKey = jlimit (0, 128, in.readInt ());
+            zone.keys = { firstKey, jlimit (firstKey, 128, in.readInt ()) };
+
+            const auto firstVelocity = jlimit (0, 128, in.readInt ());
+            zone.velocities = { firstVelocity, jlimit (firstVelocity, 128, in.readInt ()) };
+
+            if (! readSample (in, zone.readerFactory))
+                return false;
+
+            // A zone whose sample has gone is left out, so its notes are silent.
+            if (zone.readerFactory != nullptr)
+                result.zones.push_back (std::move (zone));
+        }
+    }
+
+    state = std::move (result);
+    return true;
+}
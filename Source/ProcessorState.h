@@ -0,0 +1,67 @@
+#pragma once
+
+#include "DSP/AudioFormatReaderFactory.h"
+
+// Describes one zone of a multi-sampled instrument, before its sample is loaded.
+// The fields mean the same as SampleZone's.
+struct SampleZoneSource
+{
+    std::unique_ptr<AudioFormatReaderFactory> readerFactory;
+    int rootNote = -1;
+    Range<int> keys { 0, 128 };
+    Range<int> velocities { 0, 128 };
+
+    SampleZoneSource clone () const
+    {
+        return { readerFactory == nullptr ? nullptr : readerFactory->clone (), rootNote, keys, velocities };
+    }
+};
+
+//=====================================================
+
+// Everything the user can change about the processor. This is what an editor is
+// opened with, and what the host saves and restores.
+struct ProcessorState
+{
+    int synthVoices;
+    bool legacyModeEnabled;
+    Range<int> legacyChannels;
+    int legacyPitchbendRange;
+    bool voiceStealingEnabled;
+    MPEZoneLayout mpeZoneLayout;
+    std::unique_ptr<AudioFormatReaderFactory> readerFactory;
+
+    // The zones of a multi-sampled instrument, which is played instead of the
+    // sample above when there are any.
+    std::vector<SampleZoneSource> zones;
+
+    double centreFrequencyHz;
+    InterpolationMode interpolationMode;
+    int renderThreads;
+    bool streamFromDisk;
+    double streamPreloadSeconds;
+};
+
+//=====================================================
+
+// Reads and writes ProcessorStates in a small, versioned binary format.
+//
+// Each sample (the single sample, and the sample of every zone) is saved as a
+// reference to its file, along with a fingerprint of the file's contents, so
+// that we can tell if the file has changed since. Small samples (and samples
+// that didn't come from a file to begin with) are embedded in full, and the
+// embedded copy is used if the file is missing or has changed.
+namespace ProcessorStateFormat
+{
+    // Samples up to this size are embedded in the saved state.
+    constexpr int64 maxEmbeddedSampleBytes = 1024 * 1024;
+
+    // States with more zones than this are refused. It's one per note and velocity.
+    constexpr int maxZones = 128 * 128;
+
+    void write (const ProcessorState& state, OutputStream& out);
+
+    // Returns false if the data isn't a state that we know how to read, in
+    // which case 'state' is left untouched.
+    bool read (InputStream& in, ProcessorState& state);
+}
@@ -0,0 +1,308 @@
+// The interceptors below replace C library functions, which mustn't already be
+// defined as fortified inline wrappers.
+#undef _FORTIFY_SOURCE
+
+#include "RealtimeDebug.h"
+
+#include <set>
+
+// On Linux with glibc, we can intercept the C library itself, which catches
+// everything: operator new (aligned or not), malloc from C code, and every lock
+// and blocking call JUCE makes. This only works where the definitions below take precedence over
+// the C library's, which is the case for executables (the benchmarks and the
+// standalone app) but generally not for plugins loaded by a host.
+//
+// Everywhere else, we can only replace the global operator new and delete.
+#if SAMPLER_REALTIME_CHECKS && JUCE_LINUX && defined (__GLIBC__)
+ #include <cerrno>
+ #include <dlfcn.h>
+ #define SAMPLER_INTERCEPT_LIBC 1
+#else
+ #define SAMPLER_INTERCEPT_LIBC 0
+#endif
+
+const char* RealtimeDebug::getViolationName (Violation type) noexcept
+{
+    switch (type)
+    {
+        case Violation::allocation:     return "allocation";
+        case Violation::deallocation:   return "deallocation";
+        case Violation::lock:           return "lock";
+        case Violation::blockingCall:   return "blocking call";
+        case Violation::destruction:    return "destruction";
+    }
+
+    return "unknown";
+}
+
+#if SAMPLER_TRACK_AUDIO_THREAD
+namespace
+{
+std::atomic<int64> violationCounts[RealtimeDebug::numViolationTypes] {};
+std::atomic<int64> permittedCounts[RealtimeDebug::numViolationTypes] {};
+
+// Set while a violation is being logged. Logging allocates, locks and writes to
+// stderr, none of which should be reported in turn.
+thread_local bool reporting = false;
+
+// The call stacks we've already logged, so that a violation which happens on
+// every block is only logged once.
+CriticalSection& getLoggedStacksLock ()
+{
+    static CriticalSection lock;
+    return lock;
+}
+
+std::set<int64>& getLoggedStacks ()
+{
+    static std::set<int64> stacks;
+    return stacks;
+}
+} // namespace
+
+void RealtimeDebug::reportViolation (Violation type, const char* what) noexcept
+{
+    if (! insideAudioCallback || reporting)
+        return;
+
+    if ((permittedViolations & (1 << (int) type)) != 0)
+    {
+        ++permittedCounts[(int) type];
+        return;
+    }
+
+    ++violationCounts[(int) type];
+
+    const ScopedValueSetter<bool> reportingSetter (reporting, true);
+    const auto stack = SystemStats::getStackBacktrace ();
+
+    {
+        const ScopedLock sl (getLoggedStacksLock ());
+
+        if (! getLoggedStacks ().insert (stack.hashCode64 ()).second)
+            return;
+    }
+
+    Logger::writeToLog ("Realtime violation on the audio thread (" + String (getViolationName (type)) + "): "
+                        + what + newLine + stack);
+}
+
+int64 RealtimeDebug::getNumViolations (Violation type) noexcept
+{
+    return violationCounts[(int) type].load ();
+}
+
+int64 RealtimeDebug::getTotalViolations () noexcept
+{
+    int64 total = 0;
+
+    for (const auto& count : violationCounts)
+        total += count.load ();
+
+    return total;
+}
+
+int64 RealtimeDebug::getNumPermittedViolations (Violation type) noexcept
+{
+    return permittedCounts[(int) type].load ();
+}
+
+void RealtimeDebug::resetViolations () noexcept
+{
+    for (auto& count : violationCounts)
+        count = 0;
+
+    for (auto& count : permittedCounts)
+        count = 0;
+}
+#else
+void RealtimeDebug::reportViolation (Violation, const char*) noexcept {}
+int64 RealtimeDebug::getNumViolations (Violation) noexcept { return 0; }
+int64 RealtimeDebug::getTotalViolations () noexcept { return 0; }
+int64 RealtimeDebug::getNumPermittedViolations (Violation) noexcept { return 0; }
+void RealtimeDebug::resetViolations () noexcept {}
+#endif
+
+//==============================================================================
+#if SAMPLER_INTERCEPT_LIBC
+namespace
+{
+template <typename Function>
+Function findNext (const char* name)
+{
+    auto* next = reinterpret_cast<Function> (dlsym (RTLD_NEXT, name));
+    jassert (next != nullptr);
+    return next;
+}
+} // namespace
+
+// The allocator is called before dlsym() is usable, and by dlsym() itself, so
+// it forwards to glibc's own entry points instead of looking them up.
+extern "C"
+{
+void* __libc_malloc (size_t);
+void* __libc_calloc (size_t, size_t);
+void* __libc_realloc (void*, size_t);
+void* __libc_memalign (size_t, size_t);
+void __libc_free (void*);
+
+void* malloc (size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "malloc");
+    return __libc_malloc (size);
+}
+
+void* calloc (size_t num, size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "calloc");
+    return __libc_calloc (num, size);
+}
+
+void* realloc (void* ptr, size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "realloc");
+    return __libc_realloc (ptr, size);
+}
+
+// The aligned forms of operator new allocate through these, not malloc.
+void* aligned_alloc (size_t alignment, size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "aligned_alloc");
+    return __libc_memalign (alignment, size);
+}
+
+void* memalign (size_t alignment, size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "memalign");
+    return __libc_memalign (alignment, size);
+}
+
+int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "posix_memalign");
+
+    if (alignment % sizeof (void*) != 0 || ! isPowerOfTwo (alignment))
+        return EINVAL;
+
+    auto* ptr = __libc_memalign (alignment, size);
+
+    if (ptr == nullptr)
+        return ENOMEM;
+
+    *result = ptr;
+    return 0;
+}
+
+void free (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeDebug::reportViolation (RealtimeDebug::Violation::deallocation, "free");
+
+    __libc_free (ptr);
+}
+
+int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+{
+    static const auto next = findNext<decltype (&pthread_mutex_lock)> ("pthread_mutex_lock");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::lock, "pthread_mutex_lock");
+    return next (mutex);
+}
+
+int pthread_rwlock_rdlock (pthread_rwlock_t* lock) noexcept
+{
+    static const auto next = findNext<decltype (&pthread_rwlock_rdlock)> ("pthread_rwlock_rdlock");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::lock, "pthread_rwlock_rdlock");
+    return next (lock);
+}
+
+int pthread_rwlock_wrlock (pthread_rwlock_t* lock) noexcept
+{
+    static const auto next = findNext<decltype (&pthread_rwlock_wrlock)> ("pthread_rwlock_wrlock");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::lock, "pthread_rwlock_wrlock");
+    return next (lock);
+}
+
+ssize_t read (int fd, void* buffer, size_t numBytes)
+{
+    static const auto next = findNext<decltype (&read)> ("read");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::blockingCall, "read");
+    return next (fd, buffer, numBytes);
+}
+
+ssize_t write (int fd, const void* buffer, size_t numBytes)
+{
+    static const auto next = findNext<decltype (&write)> ("write");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::blockingCall, "write");
+    return next (fd, buffer, numBytes);
+}
+
+int nanosleep (const timespec* duration, timespec* remaining)
+{
+    static const auto next = findNext<decltype (&nanosleep)> ("nanosleep");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::blockingCall, "nanosleep");
+    return next (duration, remaining);
+}
+
+int usleep (useconds_t microseconds)
+{
+    static const auto next = findNext<decltype (&usleep)> ("usleep");
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::blockingCall, "usleep");
+    return next (microseconds);
+}
+} // extern "C"
+
+#elif SAMPLER_REALTIME_CHECKS
+ #if JUCE_WINDOWS
+  #include <malloc.h>
+ #endif
+
+// The nothrow, sized and array forms of new and delete end up in these four.
+// The aligned forms are separate, in libc++ and MSVC's runtime as well as
+// libstdc++, so they're replaced too.
+void* operator new (std::size_t size)
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "operator new");
+
+    if (auto* ptr = std::malloc (size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc ();
+}
+
+void operator delete (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeDebug::reportViolation (RealtimeDebug::Violation::deallocation, "operator delete");
+
+    std::free (ptr);
+}
+
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    RealtimeDebug::reportViolation (RealtimeDebug::Violation::allocation, "operator new");
+
+   #if JUCE_WINDOWS
+    if (auto* ptr = _aligned_malloc (size > 0 ? size : 1, (size_t) alignment))
+        return ptr;
+   #else
+    void* ptr = nullptr;
+
+    if (posix_memalign (&ptr, jmax ((size_t) alignment, sizeof (void*)), size > 0 ? size : 1) == 0)
+        return ptr;
+   #endif
+
+    throw std::bad_alloc ();
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeDebug::reportViolation (RealtimeDebug::Violation::deallocation, "operator delete");
+
+   #if JUCE_WINDOWS
+    _aligned_free (ptr);
+   #else
+    std::free (ptr);
+   #endif
+}
+#endif
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+// Bookkeeping which checks that the audio thread stays realtime-safe.
+//
+// In debug builds, the heavyweight objects the audio thread works with (samples,
+// keymaps, voices and commands) call noteDestruction() from their destructors,
+// which counts (and asserts on) any destruction inside an AudioThreadScope.
+//
+// Building with SAMPLER_REALTIME_CHECKS=1 goes further, in any build type: it
+// also intercepts heap allocations, frees, mutex locks and blocking system calls
+// made inside an AudioThreadScope. Each distinct violation is logged once, with
+// a stack trace, and every one is counted by type. See RealtimeDebug.cpp for
+// what can be intercepted on each platform.
+//
+// Otherwise, all of this compiles away to nothing.
+#ifndef SAMPLER_REALTIME_CHECKS
+ #define SAMPLER_REALTIME_CHECKS 0
+#endif
+
+#if JUCE_DEBUG || SAMPLER_REALTIME_CHECKS
+ #define SAMPLER_TRACK_AUDIO_THREAD 1
+#else
+ #define SAMPLER_TRACK_AUDIO_THREAD 0
+#endif
+
+namespace RealtimeDebug
+{
+enum class Violation
+{
+    allocation = 0,
+    deallocation,
+    lock,
+    blockingCall,
+    destruction
+};
+
+constexpr int numViolationTypes = 5;
+
+const char* getViolationName (Violation type) noexcept;
+
+#if SAMPLER_TRACK_AUDIO_THREAD
+inline thread_local bool insideAudioCallback = false;
+
+// A bit for each Violation that's currently permitted on this thread.
+inline thread_local int permittedViolations = 0;
+#endif
+
+// Counts the violation, and logs it the first time it's seen from this call
+// stack, if the calling thread is inside an AudioThreadScope. A permitted
+// violation is counted separately, and isn't logged.
+void reportViolation (Violation type, const char* what) noexcept;
+
+// Marks the current thread as running the audio callback, for as long as this
+// object is in scope.
+struct AudioThreadScope
+{
+   #if SAMPLER_TRACK_AUDIO_THREAD
+    AudioThreadScope () : wasInside (insideAudioCallback) { insideAudioCallback = true; }
+    ~AudioThreadScope () { insideAudioCallback = wasInside; }
+
+    const bool wasInside;
+   #else
+    AudioThreadScope () = default;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (AudioThreadScope)
+};
+
+// Counts one type of violation on the current thread as permitted, rather than
+// reporting it, for as long as this object is in scope. Only for calls into
+// code we can't change, where we know the violation is harmless, and only
+// around those calls.
+struct ScopedPermission
+{
+   #if SAMPLER_TRACK_AUDIO_THREAD
+    explicit ScopedPermission (Violation type) : previous (permittedViolations)
+    {
+        permittedViolations |= 1 << (int) type;
+    }
+
+    ~ScopedPermission () { permittedViolations = previous; }
+
+    const int previous;
+   #else
+    explicit ScopedPermission (Violation) {}
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedPermission)
+};
+
+// Withdraws every permission on the current thread, for as long as this object
+// is in scope. For our own code, when it's called back from inside a call that
+// has been given a permission.
+struct ScopedNoPermissions
+{
+   #if SAMPLER_TRACK_AUDIO_THREAD
+    ScopedNoPermissions () : previous (permittedViolations) { permittedViolations = 0; }
+    ~ScopedNoPermissions () { permittedViolations = previous; }
+
+    const int previous;
+   #else
+    ScopedNoPermissions () = default;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedNoPermissions)
+};
+
+inline void noteDestruction () noexcept
+{
+   #if SAMPLER_TRACK_AUDIO_THREAD
+    if (insideAudioCallback)
+    {
+        reportViolation (Violation::destruction, "destroyed a tracked object");
+
+        // This should have been handed back to the message thread instead.
+        jassertfalse;
+    }
+   #endif
+}
+
+// True if allocations, locks and blocking calls are being intercepted.
+constexpr bool areChecksEnabled () noexcept { return SAMPLER_REALTIME_CHECKS != 0; }
+
+// The number of violations of the given type inside an audio callback so far,
+// on any thread. This should always be zero, and is always zero when nothing is
+// being tracked.
+int64 getNumViolations (Violation type) noexcept;
+int64 getTotalViolations () noexcept;
+
+// The number of violations of the given type inside an audio callback that a
+// ScopedPermission allowed. These are expected, but shouldn't grow with the
+// number of voices.
+int64 getNumPermittedViolations (Violation type) noexcept;
+
+// Resets both counts.
+void resetViolations () noexcept;
+
+inline int64 getNumAudioThreadDestructions () noexcept
+{
+    return getNumViolations (Violation::destruction);
+}
+} // namespace RealtimeDebug
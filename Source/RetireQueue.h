@@ -0,0 +1,60 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+#include "RealtimeDebug.h"
+
+// Takes ownership of objects that the audio thread has finished with, and
+// destroys them later on the message thread, so that the audio thread never
+// has to free any memory.
+//
+// The queue is a fixed-size, wait-free FIFO with a single writer (the audio
+// thread) and a single reader (a message-thread timer). If it ever fills up,
+// the object is destroyed immediately instead, which will trip an assertion in
+// debug builds.
+template <typename Object>
+class RetireQueue final : private Timer
+{
+public:
+    explicit RetireQueue (int capacity)
+        : slots ((size_t) capacity),
+        fifo (capacity)
+    {
+        startTimer (100);
+    }
+
+    ~RetireQueue () override
+    {
+        stopTimer ();
+        collect ();
+    }
+
+    // Audio thread only.
+    void retire (std::unique_ptr<Object> object) noexcept
+    {
+        if (object == nullptr)
+            return;
+
+        const auto scope = fifo.write (1);
+
+        // The queue is full: the timer isn't keeping up, or capacity is too small.
+        jassert (scope.blockSize1 + scope.blockSize2 == 1);
+
+        scope.forEach ([&] (int index) { slots[(size_t) index] = std::move (object); });
+    }
+
+    // Message thread only. Destroys everything that has been retired so far.
+    void collect ()
+    {
+        fifo.read (fifo.getNumReady ()).forEach ([this] (int index) { slots[(size_t) index].reset (); });
+    }
+
+private:
+    void timerCallback () override { collect (); }
+
+    std::vector<std::unique_ptr<Object>> slots;
+    AbstractFifo fifo;
+
+    JUCE_DECLARE_NON_COPYABLE (RetireQueue)
+};
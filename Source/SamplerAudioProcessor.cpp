@@ -1,187 +1,616 @@
 #include "SamplerAudioProcessor.h"
 #include "GUI/SamplerAudioEditor.h"
 
+namespace
+{
+std::vector<SampleZoneSource> cloneZones (const std::vector<SampleZoneSource>& zones)
+{
+    std::vector<SampleZoneSource> result;
+    result.reserve (zones.size ());
+
+    for (const auto& zone : zones)
+        result.push_back (zone.clone ());
+
+    return result;
+}
+} // namespace
+
 SamplerAudioProcessor::SamplerAudioProcessor ()
     : AudioProcessor (BusesProperties ().withOutput ("Output", AudioChannelSet::stereo (), true))
 {
-    //load wavefile in a memory block
-    const juce::File celloWav ("C:/Users/barth/Documents/git/JUCE/examples/Assets/cello.wav");
-    const auto inputStream = celloWav.createInputStream ();
-    jassert (inputStream);  //should probably return if this is triggered
-    inputStream->readIntoMemoryBlock (memoryBlock);
-
-    //create a reader factory with the memory block
-    readerFactory.reset (new MemoryAudioFormatReaderFactory (memoryBlock.getData (), memoryBlock.getSize ()));
+    SAMPLER_TRACE_THREAD ("Message thread");
 
-    //get a reader from the reader factory
-    AudioFormatManager manager;
-    manager.registerBasicFormats ();
-    const auto reader = readerFactory->make (manager);
-    jassert (reader != nullptr); // Failed to load resource!
+    samplerSound->setSincTables (&sincTables);
+    loaderFormatManager.registerBasicFormats ();
+    summariserFormatManager.registerBasicFormats ();
 
-    //Read the sample into an OurSample, and move our sample to our SamplerSound
-    //copying the shared samplerSound pointer increases its reference count,
-    //which will be decreased when the soundCopy is deleted
+    // Start out silent. The voices are created once, here, and reused for every
+    // sample after this. There are as many as the editor starts out with, so
+    // opening it doesn't replace them all.
     auto sound = samplerSound;
-    sound->setSample (std::make_unique<OurSample>(*reader, 10.0));
+    auto keymap = std::make_shared<const Keymap> ();
+    sound->swapKeymap (keymap);
 
-    //create maxVoices, which all use copies of our shared pointer sound
-    for (auto i = 0; i != maxVoices; ++i)
-        synthesiser.addVoice (new OurSamplerVoice (sound));
+    for (auto i = 0; i != defaultNumVoices; ++i)
+        synthesiser.addVoice (new OurSamplerVoice (sound, voiceBank));
+
+    // The audio thread isn't running yet, so it's safe to publish from here.
+    zoneLayout = synthesiser.getZoneLayout ();
+    requestedNumVoices = synthesiser.getNumVoices ();
+    requestedLegacyMode = synthesiser.isLegacyModeEnabled ();
+    requestedLegacyPitchbendRange = synthesiser.getLegacyModePitchbendRange ();
+    requestedLegacyChannels = synthesiser.getLegacyModeChannelRange ();
+    publishSynthState ();
+
+    // There's no sample until the host restores one, or the user picks one.
+    // The editor says so, rather than leaving the user to wonder why it's silent.
+    requestedStateChanged ();
 }
 
 AudioProcessorEditor* SamplerAudioProcessor::createEditor ()
 {
-    // This function will be called from the message thread, so lock the command
-    // queue to ensure that no messages are processed while in here
-    SpinLock::ScopedLockType lock (commandQueueMutex);
+    // The editor starts out with what was last asked for, rather than with what
+    // the audio thread has got round to, or it would push stale settings back.
+    return new SamplerAudioProcessorEditor (*this, getRequestedState ());
+}
 
+ProcessorState SamplerAudioProcessor::getRequestedState () const
+{
     ProcessorState state;
-    state.synthVoices = synthesiser.getNumVoices ();
-    state.legacyModeEnabled = synthesiser.isLegacyModeEnabled ();
-    state.legacyChannels = synthesiser.getLegacyModeChannelRange ();
-    state.legacyPitchbendRange = synthesiser.getLegacyModePitchbendRange ();
-    state.voiceStealingEnabled = synthesiser.isVoiceStealingEnabled ();
-    state.mpeZoneLayout = synthesiser.getZoneLayout ();
+    state.synthVoices = requestedNumVoices;
+    state.legacyModeEnabled = requestedLegacyMode;
+    state.legacyChannels = requestedLegacyChannels;
+    state.legacyPitchbendRange = requestedLegacyPitchbendRange;
+    state.voiceStealingEnabled = voiceStealingEnabled.get ();
+    state.mpeZoneLayout = zoneLayout;
     state.readerFactory = readerFactory == nullptr ? nullptr : readerFactory->clone ();
+    state.zones = cloneZones (requestedZones);
+    state.centreFrequencyHz = centreFrequency.get ();
+    state.interpolationMode = (InterpolationMode) interpolationMode.get ();
+    state.renderThreads = parallelRenderer.getNumThreads ();
+    state.streamFromDisk = streamFromDisk;
+    state.streamPreloadSeconds = streamPreloadSeconds;
+    return state;
+}
 
-    auto sound = samplerSound;
-    state.centreFrequencyHz = sound->getCentreFrequencyInHz ();
+void SamplerAudioProcessor::requestedStateChanged ()
+{
+    std::shared_ptr<const ProcessorState> state = std::make_shared<ProcessorState> (getRequestedState ());
+
+    // The old state is released after the lock.
+    const ScopedLock sl (pendingStateLock);
+    std::swap (savedState, state);
+}
+
+void SamplerAudioProcessor::getStateInformation (MemoryBlock& destData)
+{
+    // Hosts may call this on any thread, so it only reads the copy that the
+    // message thread keeps up to date. The copy is never modified, so it can be
+    // written out once the lock is released.
+    std::shared_ptr<const ProcessorState> state;
+
+    {
+        const ScopedLock sl (pendingStateLock);
+
+        // A state that hasn't been restored yet is still the one we're about to have.
+        if (pendingState.getSize () > 0)
+        {
+            destData = pendingState;
+            return;
+        }
+
+        state = savedState;
+    }
+
+    if (state == nullptr)
+        return;
+
+    MemoryOutputStream out (destData, false);
+    ProcessorStateFormat::write (*state, out);
+}
+
+void SamplerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    // Everything that restoring a state sets in motion (the loader, the
+    // command queue) has to be driven from the message thread.
+    if (! MessageManager::existsAndIsCurrentThread ())
+    {
+        {
+            const ScopedLock sl (pendingStateLock);
+            pendingState.replaceAll (data, (size_t) sizeInBytes);
+        }
+
+        triggerAsyncUpdate ();
+        return;
+    }
+
+    // This state is newer than one still waiting for the async update, which
+    // mustn't be restored over it, or saved in its place.
+    {
+        const ScopedLock sl (pendingStateLock);
+        pendingState.reset ();
+    }
+
+    restoreState (data, (size_t) sizeInBytes);
+}
+
+void SamplerAudioProcessor::handleAsyncUpdate ()
+{
+    MemoryBlock state;
+
+    {
+        const ScopedLock sl (pendingStateLock);
+        std::swap (state, pendingState);
+    }
+
+    if (state.getSize () > 0)
+        restoreState (state.getData (), state.getSize ());
+}
+
+void SamplerAudioProcessor::restoreState (const void* data, size_t sizeInBytes)
+{
+    MemoryInputStream in (data, sizeInBytes, false);
+    ProcessorState state;
+
+    if (ProcessorStateFormat::read (in, state))
+        restoreState (std::move (state));
+}
+
+void SamplerAudioProcessor::restoreState (ProcessorState state)
+{
+    // The streaming options must be in place before the sample is loaded.
+    setStreamingOptions (state.streamFromDisk, state.streamPreloadSeconds);
+    setNumRenderThreads (state.renderThreads);
+    setCentreFrequency (state.centreFrequencyHz);
+    setInterpolationMode (state.interpolationMode);
+    setVoiceStealingEnabled (state.voiceStealingEnabled);
+    setNumberOfVoices (state.synthVoices);
+
+    if (state.legacyModeEnabled)
+        setLegacyModeEnabled (state.legacyPitchbendRange, state.legacyChannels);
+    else
+        setMPEZoneLayout (state.mpeZoneLayout);
+
+    if (! state.zones.empty ())
+        setZones (cloneZones (state.zones));
+    else
+        setSample (state.readerFactory == nullptr ? nullptr : state.readerFactory->clone ());
+
+    // The editor's own model would otherwise be out of date. Its listeners pass
+    // the state straight back to us. The setters that would rebuild the voices,
+    // queue a command or load the sample skip values they already have. The
+    // simple settings are just set again. The editor doesn't reload the sample
+    // for the streaming options either.
+    if (auto* editor = dynamic_cast<SamplerAudioProcessorEditor*> (getActiveEditor ()))
+        editor->setState (std::move (state));
+}
+
+void SamplerAudioProcessor::setSample (std::unique_ptr<AudioFormatReaderFactory> factory)
+{
+    if (factory == nullptr)
+    {
+        // The editor only knows about single samples, so it hands back an empty
+        // one while zones are playing. That isn't a request to stop them.
+        if (readerFactory == nullptr && ! requestedZones.empty ())
+            return;
+
+        loader.cancel ();
+        readerFactory = nullptr;
+        pendingSampleKey = {};
+        requestedStateChanged ();
+        setKeymap (nullptr, {}, std::make_shared<const Keymap> (), {});
+        return;
+    }
+
+    requestedZones.clear ();
+
+    const auto options = getSampleLoadOptions ();
+    const auto key = getSampleKey (*factory, options);
+
+    // Opening an editor hands us back the sample we were last asked for, which
+    // is either playing already or on its way, so there's nothing to do. Going
+    // back to the playing sample while another one loads is a new request, which
+    // the pool serves without decoding anything.
+    if (key.isNotEmpty ())
+    {
+        const auto loading = loader.isLoading ();
+
+        if (key == loadedSampleKey && ! loading)
+        {
+            // An earlier load may have failed, leaving a different sample requested.
+            readerFactory = std::move (factory);
+            requestedStateChanged ();
+            return;
+        }
+
+        if (key == pendingSampleKey && loading)
+            return;
+    }
+
+    readerFactory = factory->clone ();
+    pendingSampleKey = key;
+    requestedStateChanged ();
+
+    // Jobs have to be copyable, so the factory is shared with the job.
+    std::shared_ptr<const AudioFormatReaderFactory> source = std::move (factory);
+
+    loader.load ([this, source, options, key] (const OurSample::ProgressCallback& progress) -> std::function<void ()>
+        {
+            auto sample = loadSample (*source, *samplePool, loaderFormatManager, options, progress);
+
+            if (sample == nullptr)
+                return nullptr;
+
+            auto keymap = Keymap::withSingleSample (std::move (sample));
+            return [this, source, keymap, key] { setKeymap (source->clone (), {}, keymap, key); };
+        });
+}
+
+void SamplerAudioProcessor::setZones (std::vector<SampleZoneSource> zones)
+{
+    readerFactory = nullptr;
+    requestedZones = cloneZones (zones);
+    pendingSampleKey = {};
+    requestedStateChanged ();
+
+    // Jobs have to be copyable, so the zones are shared with the job.
+    auto sources = std::make_shared<const std::vector<SampleZoneSource>> (std::move (zones));
+    const auto options = getSampleLoadOptions ();
+
+    loader.load ([this, sources, options] (const OurSample::ProgressCallback& progress) -> std::function<void ()>
+        {
+            const auto numSources = (int) sources->size ();
+            std::vector<SampleZone> keymapZones;
+            auto loaded = std::make_shared<std::vector<SampleZoneSource>> ();
+
+            for (auto i = 0; i < numSources; ++i)
+            {
+                const auto& source = (*sources)[(size_t) i];
+
+                // Each zone accounts for an equal share of the overall progress.
+                const OurSample::ProgressCallback zoneProgress = [&progress, i, numSources] (double fraction)
+                    {
+                        return progress ((i + fraction) / numSources);
+                    };
+
+                auto sample = source.readerFactory != nullptr
+                            ? loadSample (*source.readerFactory, *samplePool, loaderFormatManager, options, zoneProgress)
+                            : nullptr;
+
+                if (! progress ((double) (i + 1) / numSources))
+                    return nullptr;
+
+                // Zones whose samples can't be loaded are left out, so their notes are silent.
+                if (sample == nullptr)
+                    continue;
+
+                SampleZone zone;
+                zone.sample = std::move (sample);
+                zone.rootNote = source.rootNote;
+                zone.keys = source.keys;
+                zone.velocities = source.velocities;
+                keymapZones.push_back (std::move (zone));
+                loaded->push_back (source.clone ());
+            }
+
+            auto keymap = std::make_shared<const Keymap> (std::move (keymapZones));
+            return [this, loaded, keymap] { setKeymap (nullptr, cloneZones (*loaded), keymap, {}); };
+        });
+}
 
-    return new SamplerAudioProcessorEditor (*this, std::move (state));
+void SamplerAudioProcessor::reloadZones ()
+{
+    if (! requestedZones.empty ())
+        setZones (cloneZones (requestedZones));
 }
 
-void SamplerAudioProcessor::setSample (std::unique_ptr<AudioFormatReaderFactory> factory,
-                                       AudioFormatManager& formatManager)
+void SamplerAudioProcessor::cancelSampleLoading ()
 {
-    class SetSampleCommand
+    loader.cancel ();
+
+    // Carry on asking for the sample that's still playing.
+    readerFactory = loadedReaderFactory == nullptr ? nullptr : loadedReaderFactory->clone ();
+    requestedZones = cloneZones (loadedZones);
+    pendingSampleKey = {};
+    requestedStateChanged ();
+}
+
+void SamplerAudioProcessor::setKeymap (std::unique_ptr<AudioFormatReaderFactory> factory,
+                                       std::vector<SampleZoneSource> zones,
+                                       std::shared_ptr<const Keymap> keymap,
+                                       const String& sampleKey)
+{
+    class SetKeymapCommand
     {
     public:
-        SetSampleCommand (std::unique_ptr<AudioFormatReaderFactory> r,
-                          std::unique_ptr<OurSample> sampleIn,
-                          std::vector<std::unique_ptr<OurSamplerVoice>> newVoicesIn) :
-            readerFactory (std::move (r)),
-            sample (std::move (sampleIn)),
-            newVoices (std::move (newVoicesIn))
+        explicit SetKeymapCommand (std::shared_ptr<const Keymap> keymapIn) :
+            keymap (std::move (keymapIn))
         {
         }
 
+        // The old keymap ends up in this command, which is destroyed on the
+        // message thread.
         void operator() (SamplerAudioProcessor& proc)
         {
-            proc.readerFactory = std::move (readerFactory);
-            auto sound = proc.samplerSound;
-            sound->setSample (std::move (sample));
-            auto numberOfVoices = proc.synthesiser.getNumVoices ();
-            proc.synthesiser.clearVoices ();
+            SAMPLER_TRACE_SCOPE ("SetKeymapCommand");
 
-            for (auto it = begin (newVoices); proc.synthesiser.getNumVoices () < numberOfVoices; ++it)
+            // The voices' slots point into the old keymap, so they have to go
+            // first. The voices themselves carry on with the new one.
             {
-                proc.synthesiser.addVoice (it->release ());
+                const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
+                proc.synthesiser.turnOffAllVoices (false);
+                proc.synthesiser.releaseVoiceSlots ();
             }
+
+            auto sound = proc.samplerSound;
+            sound->swapKeymap (keymap);
         }
 
     private:
-        std::unique_ptr<AudioFormatReaderFactory> readerFactory;
-        std::unique_ptr<OurSample> sample;
-        std::vector<std::unique_ptr<OurSamplerVoice>> newVoices;
+        std::shared_ptr<const Keymap> keymap;
     };
 
-    // Note that all allocation happens here, on the main message thread. Then,
-    // we transfer ownership across to the audio thread.
-    auto loadedSamplerSound = samplerSound;
-    std::vector<std::unique_ptr<OurSamplerVoice>> newSamplerVoices;
-    newSamplerVoices.reserve (maxVoices);
+    loadedReaderFactory = std::move (factory);
+    loadedZones = std::move (zones);
+    loadedSampleKey = sampleKey;
 
-    for (auto i = 0; i != maxVoices; ++i)
-        newSamplerVoices.emplace_back (new OurSamplerVoice (loadedSamplerSound));
+    // The waveform shows the first zone's sample.
+    auto sample = keymap->getNumZones () > 0 ? keymap->getZone (0).sample : nullptr;
+    const auto* source = loadedZones.empty () ? loadedReaderFactory.get ()
+                                              : loadedZones.front ().readerFactory.get ();
 
-    if (factory == nullptr)
+    // The streamer only sets itself up once there's something to stream. The
+    // command queue publishes its streams to the audio thread along with the keymap.
+    for (auto i = 0; i < keymap->getNumZones (); ++i)
     {
-        commands.push (SetSampleCommand (std::move (factory),
-                                         nullptr,
-                                         std::move (newSamplerVoices)));
+        if (keymap->getZone (i).sample->isStreaming ())
+        {
+            streamer.start ();
+            break;
+        }
     }
-    else if (auto reader = factory->make (formatManager))
+
+    commands.push (SetKeymapCommand (std::move (keymap)));
+
+    summariseLoadedSample (std::move (sample), source);
+}
+
+void SamplerAudioProcessor::summariseLoadedSample (std::shared_ptr<const OurSample> sample,
+                                                   const AudioFormatReaderFactory* factory)
+{
+    // Another instance may have summarised this sample already.
+    loadedPeakPyramid = sample != nullptr ? sample->getPeakPyramid () : nullptr;
+
+    if (loadedPeakPyramid != nullptr || sample == nullptr || factory == nullptr)
     {
-        commands.push (SetSampleCommand (std::move (factory),
-                                         std::unique_ptr<OurSample> (new OurSample (*reader, 10.0)),
-                                         std::move (newSamplerVoices)));
+        summariser.cancel ();
+        return;
     }
+
+    std::shared_ptr<const AudioFormatReaderFactory> source = factory->clone ();
+
+    summariser.load ([this, sample, source] (const OurSample::ProgressCallback& progress) -> std::function<void ()>
+        {
+            SAMPLER_TRACE_SCOPE ("build peak pyramid");
+
+            // The streamer is reading the same sample, so a streaming sample is
+            // summarised through a reader of our own.
+            auto reader = sample->isStreaming () ? source->make (summariserFormatManager) : nullptr;
+            auto pyramid = PeakPyramid::build (*sample, reader.get (), progress);
+
+            if (pyramid == nullptr)
+                return nullptr;
+
+            sample->setPeakPyramid (pyramid);
+            return [this, pyramid] { loadedPeakPyramid = pyramid; };
+        });
 }
 
-void SamplerAudioProcessor::setCentreFrequency (double centreFrequency)
+std::shared_ptr<const OurSample> SamplerAudioProcessor::loadSample (const AudioFormatReaderFactory& factory,
+                                                                    SamplePool& pool,
+                                                                    AudioFormatManager& formatManager,
+                                                                    SampleLoadOptions options,
+                                                                    const OurSample::ProgressCallback& progress)
 {
-    commands.push ([centreFrequency](SamplerAudioProcessor& proc)
-                   {
-                       auto loaded = proc.samplerSound;
-                       if (loaded != nullptr)
-                           loaded->setCentreFrequencyInHz (centreFrequency);
-                   });
+    return pool.getOrLoad (getSampleKey (factory, options), [&]
+        {
+            auto reader = factory.make (formatManager);
+
+            // OurSample throws on an empty sample, and nothing on the loading
+            // thread would catch it. A header-only file, or one without a
+            // sample rate, counts as one that couldn't be read.
+            if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+                return std::shared_ptr<const OurSample> ();
+
+            auto sample = loadSample (std::move (reader), options, progress);
+
+            // Don't let a partly-decoded sample into the pool.
+            if (progress != nullptr && ! progress (1.0))
+                return std::shared_ptr<const OurSample> ();
+
+            return sample;
+        });
+}
+
+String SamplerAudioProcessor::getSampleKey (const AudioFormatReaderFactory& factory, SampleLoadOptions options)
+{
+    // The streaming options change what ends up in memory, so samples loaded
+    // with different options can't be shared.
+    const auto identity = factory.getIdentity ();
+
+    return identity.isEmpty () ? String ()
+                               : identity + "|" + String (options.streamFromDisk ? options.preloadSeconds : 0.0);
+}
+
+std::shared_ptr<const OurSample> SamplerAudioProcessor::loadSample (std::unique_ptr<AudioFormatReader> reader,
+                                                                    SampleLoadOptions options,
+                                                                    const OurSample::ProgressCallback& progress)
+{
+    SAMPLER_TRACE_SCOPE ("decode sample");
+
+    // Mapped files are loaded like any other. The mapping saves reading them
+    // through a stream, but the voices play floats, so the frames are still
+    // converted: here, or by the streamer as it goes. A file is only streamed
+    // when the user has asked for streaming. The streamer has fewer streams
+    // than we have voices, so a streamed sample can't always be played at full
+    // polyphony.
+    const auto preloadFrames = jmax ((int) SampleStreamer::minimumPreloadFrames,
+                                     roundToInt (options.preloadSeconds * reader->sampleRate));
+
+    // Other long samples are truncated to ten seconds. The waveform is
+    // summarised once the sample is playing, so that it doesn't hold that up.
+    return options.streamFromDisk && reader->lengthInSamples > preloadFrames
+         ? std::make_shared<OurSample> (std::move (reader), preloadFrames, progress)
+         : std::make_shared<OurSample> (*reader, 10.0, progress);
+}
+
+void SamplerAudioProcessor::setStreamingOptions (bool shouldStream, double preloadSeconds)
+{
+    streamFromDisk = shouldStream;
+    streamPreloadSeconds = preloadSeconds;
+    requestedStateChanged ();
 }
 
 void SamplerAudioProcessor::setMPEZoneLayout (MPEZoneLayout layout)
 {
-    commands.push ([layout](SamplerAudioProcessor& proc)
+    if (! requestedLegacyMode && layout == zoneLayout)
+        return;
+
+    zoneLayout = layout;
+    requestedLegacyMode = false;
+    requestedStateChanged ();
+
+    // A layout is too big to fit in a command slot, so it travels on the heap.
+    commands.push ([layout = std::make_unique<MPEZoneLayout> (std::move (layout))](SamplerAudioProcessor& proc)
                    {
+                       SAMPLER_TRACE_SCOPE ("SetZoneLayoutCommand");
+
                        // setZoneLayout will lock internally, so we don't care too much about
                        // ensuring that the layout doesn't get copied or destroyed on the
                        // audio thread. If the audio glitches while updating midi settings
                        // it doesn't matter too much.
-                       proc.synthesiser.setZoneLayout (layout);
+                       const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
+                       proc.synthesiser.setZoneLayout (*layout);
                    });
 }
 
 void SamplerAudioProcessor::setLegacyModeEnabled (int pitchbendRange, Range<int> channelRange)
 {
+    if (requestedLegacyMode && pitchbendRange == requestedLegacyPitchbendRange && channelRange == requestedLegacyChannels)
+        return;
+
+    requestedLegacyMode = true;
+    requestedLegacyPitchbendRange = pitchbendRange;
+    requestedLegacyChannels = channelRange;
+    requestedStateChanged ();
+
+    // The audio thread applies the latest values after the commands, so a range
+    // left over from an earlier setLegacyPitchbendRange would win otherwise. The
+    // command takes the slot's range, which is this one or a later one, so that
+    // the range isn't applied (and every note released) a second time.
+    legacyPitchbendRange.set (pitchbendRange);
+
     commands.push ([pitchbendRange, channelRange](SamplerAudioProcessor& proc)
                    {
-                       proc.synthesiser.enableLegacyMode (pitchbendRange, channelRange);
-                   });
-}
+                       SAMPLER_TRACE_SCOPE ("EnableLegacyModeCommand");
 
-void SamplerAudioProcessor::setVoiceStealingEnabled (bool voiceStealingEnabled)
-{
-    commands.push ([voiceStealingEnabled](SamplerAudioProcessor& proc)
-                   {
-                       proc.synthesiser.setVoiceStealingEnabled (voiceStealingEnabled);
+                       auto range = pitchbendRange;
+                       proc.legacyPitchbendRange.takeIfChanged (range);
+
+                       const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
+                       proc.synthesiser.enableLegacyMode (range, channelRange);
                    });
 }
 
-void SamplerAudioProcessor::setNumberOfVoices (int numberOfVoices)
+bool SamplerAudioProcessor::applyLatestValues ()
 {
-    // We don't want to call 'new' on the audio thread. Normally, we'd
-    // construct things here, on the GUI thread, and then move them into the
-    // command lambda. Unfortunately, C++11 doesn't have extended lambda
-    // capture, so we use a custom struct instead.
+    auto changed = false;
+    double frequency;
 
-    class SetNumVoicesCommand
+    if (centreFrequency.takeIfChanged (frequency))
     {
-    public:
-        SetNumVoicesCommand (std::vector<std::unique_ptr<OurSamplerVoice>> newVoicesIn)
-            : newVoices (std::move (newVoicesIn))
-        {
-        }
+        samplerSound->setCentreFrequencyInHz (frequency);
+        changed = true;
+    }
 
-        void operator() (SamplerAudioProcessor& proc)
-        {
-            if ((int) newVoices.size () < proc.synthesiser.getNumVoices ())
-                proc.synthesiser.reduceNumVoices (int (newVoices.size ()));
-            else
-                for (auto it = begin (newVoices); (size_t) proc.synthesiser.getNumVoices () < newVoices.size (); ++it)
-                    proc.synthesiser.addVoice (it->release ());
-        }
+    int mode;
 
-    private:
-        std::vector<std::unique_ptr<OurSamplerVoice>> newVoices;
-    };
+    if (interpolationMode.takeIfChanged (mode))
+    {
+        samplerSound->setInterpolationMode ((InterpolationMode) mode);
+        changed = true;
+    }
+
+    bool stealing;
+
+    if (voiceStealingEnabled.takeIfChanged (stealing))
+    {
+        synthesiser.setVoiceStealingEnabled (stealing);
+        changed = true;
+    }
+
+    int pitchbendRange;
+
+    // The range is also set whenever legacy mode is turned on, so this only
+    // matters while it's already on.
+    if (legacyPitchbendRange.takeIfChanged (pitchbendRange) && synthesiser.isLegacyModeEnabled ())
+    {
+        // This releases every note, under the instrument's lock.
+        const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
+        synthesiser.setLegacyModePitchbendRange (pitchbendRange);
+        changed = true;
+    }
+
+    return changed;
+}
+
+void SamplerAudioProcessor::publishSynthState ()
+{
+    // Every field is rewritten, because the write buffer holds whatever was
+    // published two snapshots ago.
+    auto& state = synthStates.getWriteBuffer ();
+    state.version = nextSynthStateVersion++;
+    state.synthVoices = synthesiser.getNumVoices ();
+    state.legacyModeEnabled = synthesiser.isLegacyModeEnabled ();
+    state.legacyChannels = synthesiser.getLegacyModeChannelRange ();
+    state.legacyPitchbendRange = synthesiser.getLegacyModePitchbendRange ();
+    state.voiceStealingEnabled = synthesiser.isVoiceStealingEnabled ();
+    state.centreFrequencyHz = samplerSound->getCentreFrequencyInHz ();
+    state.interpolationMode = samplerSound->getInterpolationMode ();
+    synthStates.publish ();
+}
 
+void SamplerAudioProcessor::setNumberOfVoices (int numberOfVoices)
+{
     numberOfVoices = std::min ((int) maxVoices, numberOfVoices);
+
+    if (numberOfVoices == requestedNumVoices)
+        return;
+
+    requestedNumVoices = numberOfVoices;
+    requestedStateChanged ();
+
+    SAMPLER_TRACE_SCOPE ("allocate voices");
     auto loadedSamplerSound = samplerSound;
     std::vector<std::unique_ptr<OurSamplerVoice>> newSamplerVoices;
     newSamplerVoices.reserve ((size_t) numberOfVoices);
 
     for (auto i = 0; i != numberOfVoices; ++i)
-        newSamplerVoices.emplace_back (new OurSamplerVoice (loadedSamplerSound));
+        newSamplerVoices.emplace_back (new OurSamplerVoice (loadedSamplerSound, voiceBank));
+
+    // We don't want to call 'new' on the audio thread, so the voices are
+    // constructed here, on the GUI thread, and moved into the command.
+    commands.push ([newVoices = std::move (newSamplerVoices)](SamplerAudioProcessor& proc) mutable
+                   {
+                       SAMPLER_TRACE_SCOPE ("SetNumVoicesCommand");
+
+                       // Both take the synthesiser's voice lock.
+                       const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
 
-    commands.push (SetNumVoicesCommand (std::move (newSamplerVoices)));
+                       if ((int) newVoices.size () < proc.synthesiser.getNumVoices ())
+                           proc.synthesiser.retireVoices (int (newVoices.size ()), proc.retiredVoices);
+                       else
+                           for (auto it = begin (newVoices); (size_t) proc.synthesiser.getNumVoices () < newVoices.size (); ++it)
+                               proc.synthesiser.addVoice (it->release ());
+                   });
 }
@@ -11,30 +11,59 @@
 #include <mutex>
 
 #include "Command.h"
+#include "LatestValue.h"
+#include "LoadMeter.h"
+#include "ProcessorState.h"
+#include "TripleBuffer.h"
+#include "Trace.h"
 #include "DSP/AudioFormatReaderFactory.h"
+#include "DSP/PeakPyramid.h"
+#include "DSP/SampleLoader.h"
+#include "DSP/SamplePool.h"
+#include "DSP/SamplerSynthesiser.h"
 
-struct ProcessorState
+//=====================================================
+
+// The settings which are applied on the audio thread, as they stood at the end
+// of a block. The version goes up by one each time the audio thread publishes a
+// new snapshot, which it only does when something has changed.
+struct SynthStateSnapshot
 {
-    int synthVoices;
-    bool legacyModeEnabled;
+    uint32 version = 0;
+    int synthVoices = 0;
+    bool legacyModeEnabled = false;
     Range<int> legacyChannels;
-    int legacyPitchbendRange;
-    bool voiceStealingEnabled;
-    MPEZoneLayout mpeZoneLayout;
-    std::unique_ptr<AudioFormatReaderFactory> readerFactory;
-    double centreFrequencyHz;
+    int legacyPitchbendRange = 0;
+    bool voiceStealingEnabled = false;
+    double centreFrequencyHz = 0.0;
+    InterpolationMode interpolationMode = InterpolationMode::linear;
+};
+
+//=====================================================
+
+// The playback position of every voice that was sounding at the end of a block.
+struct PlaybackSnapshot
+{
+    enum { maxVoices = 200 };
+
+    std::array<float, maxVoices> positionsInSeconds {};
+    int numActiveVoices = 0;
 };
 
 //=====================================================
 
-class SamplerAudioProcessor final : public AudioProcessor
+class SamplerAudioProcessor final : public AudioProcessor,
+                                    private AsyncUpdater
 {
 public:
     SamplerAudioProcessor();
 
-    void prepareToPlay (double sampleRate, int) override
+    void prepareToPlay (double sampleRate, int maximumBlockSize) override
     {
         synthesiser.setCurrentPlaybackSampleRate (sampleRate);
+        sincTables.prepare ();
+        parallelRenderer.prepare (maximumBlockSize, getTotalNumOutputChannels ());
+        loadMeter.prepare (sampleRate, maximumBlockSize);
     }
 
     void releaseResources() override {}
@@ -61,8 +90,9 @@ public:
     const String getProgramName (int) override                            { return "None"; }
     void changeProgramName (int, const String&) override                  {}
 
-    void getStateInformation (MemoryBlock&) override                      {}
-    void setStateInformation (const void*, int) override                  {}
+    // The sample is restored on the loading thread, so this returns straight away.
+    void getStateInformation (MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
 
     void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi) override
     {
@@ -75,43 +105,271 @@ public:
     }
 
     // These should be called from the GUI thread, and will block until the
-    // command buffer has enough room to accept a command.
-    void setSample (std::unique_ptr<AudioFormatReaderFactory> fact, AudioFormatManager& formatManager);
-    void setCentreFrequency (double centreFrequency);
+    // command buffer has enough room to accept a command (or until it's clear
+    // that the audio thread isn't running).
+    // Samples are decoded on a background thread, and only swapped in once
+    // they've finished loading. Loading a sample cancels any earlier load
+    // that's still in progress.
+    void setSample (std::unique_ptr<AudioFormatReaderFactory> fact);
+
+    // This is how to build a multi-sampled instrument, which plays instead of a
+    // single sample. Each zone gives a sample, the note at which it plays at its
+    // original pitch, and the notes and velocities it covers. The samples are
+    // loaded like setSample's, and the zones are saved with the plugin's state.
+    // Zones whose samples can't be read are left out. The editor doesn't edit
+    // zones yet, so they come from here or from a restored state.
+    // reloadZones loads them again, to pick up new streaming options, and
+    // hasZones says whether zones were the last thing asked for.
+    void setZones (std::vector<SampleZoneSource> zones);
+    void reloadZones ();
+    bool hasZones () const                      { return ! requestedZones.empty (); }
+
     void setMPEZoneLayout (MPEZoneLayout layout);
     void setLegacyModeEnabled (int pitchbendRange, Range<int> channelRange);
-    void setVoiceStealingEnabled (bool voiceStealingEnabled);
     void setNumberOfVoices (int numberOfVoices);
 
+    // Simple settings bypass the command queue. The audio thread picks up the
+    // latest value of each one at the start of the next block, so a flurry of
+    // changes costs no more than a single one.
+    void setCentreFrequency (double value)
+    {
+        centreFrequency.set (value);
+        requestedStateChanged ();
+    }
+
+    void setInterpolationMode (InterpolationMode m)
+    {
+        interpolationMode.set ((int) m);
+        requestedStateChanged ();
+    }
+
+    void setVoiceStealingEnabled (bool value)
+    {
+        voiceStealingEnabled.set (value);
+        requestedStateChanged ();
+    }
+
+    void setLegacyPitchbendRange (int value)
+    {
+        requestedLegacyPitchbendRange = value;
+        legacyPitchbendRange.set (value);
+        requestedStateChanged ();
+    }
+
+    // Unlike the setters above, this takes effect immediately, without going
+    // through the command queue.
+    void setNumRenderThreads (int numThreads)
+    {
+        parallelRenderer.setNumThreads (numThreads);
+        requestedStateChanged ();
+    }
+
+    // When streaming is enabled, samples longer than the preload time are played
+    // from disk, with only their first 'preloadSeconds' held in memory. This only
+    // affects samples loaded after the call. Otherwise, samples are decoded into
+    // memory, up to their first ten seconds.
+    void setStreamingOptions (bool streamFromDisk, double preloadSeconds);
+
+    // Message thread only. For keeping an eye on the command queue.
+    int getCommandQueueHighWaterMark() const    { return commands.getHighWaterMark(); }
+    int getNumDroppedCommands() const           { return commands.getNumDropped(); }
+
+    bool isLoadingSample() const                { return loader.isLoading(); }
+    double getSampleLoadProgress() const        { return loader.getProgress(); }
+    void cancelSampleLoading();
+
     // These accessors are just for an 'overview' and won't give the exact
     // state of the audio engine at a particular point in time.
-    // If you call getNumVoices(), get the result '10', and then call
-    // getPlaybackPosiiton (9), there's a chance the audio engine will have
-    // been updated to remove some voices in the meantime, so the returned
-    // value won't correspond to an existing voice.
     int getNumVoices() const                    { return synthesiser.getNumVoices(); }
-    float getPlaybackPosition (int voice) const { return playbackPositions.at ((size_t) voice); }
+
+    // The number of times a streaming voice has had to play silence because the
+    // disk couldn't keep up, and the number of voices that were cut short because
+    // every stream was busy.
+    int getNumStreamUnderruns() const           { return streamer.getNumUnderruns(); }
+    int getNumStreamsUnavailable() const        { return streamer.getNumStreamsUnavailable(); }
+
+    // Returns the positions of the voices that were playing at the end of the most
+    // recently rendered block. Only call this from one thread (normally the
+    // message thread); the returned reference is valid until the next call.
+    const PlaybackSnapshot& getPlaybackSnapshot()
+    {
+        playbackSnapshots.update();
+        return playbackSnapshots.getReadBuffer();
+    }
+
+    // Returns the settings that the audio thread had applied as of the last block
+    // it processed, which may lag behind what was asked for. This is only for
+    // display. Call it from one thread, as with getPlaybackSnapshot.
+    const SynthStateSnapshot& getAppliedSynthState()
+    {
+        synthStates.update();
+        return synthStates.getReadBuffer();
+    }
+
+    // Message thread only. The waveform of the sample that's playing, or nullptr
+    // if there isn't one, or if it hasn't been summarised yet.
+    std::shared_ptr<const PeakPyramid> getPeakPyramid() const { return loadedPeakPyramid; }
+
+    // How busy the audio thread is. Only read it on the message thread.
+    LoadMeter& getLoadMeter () { return loadMeter; }
+
+    // The pool that this instance shares its samples through.
+    SamplePool& getSamplePool () { return *samplePool; }
+
+    // The streams that this instance plays streaming samples through.
+    const SampleStreamer& getSampleStreamer () const { return streamer; }
 
 private:
     template <typename Element>
     void process (AudioBuffer<Element>& buffer, MidiBuffer& midiMessages);
 
+    // Message thread only. What the user has asked for, which is a step ahead of
+    // the audio thread if it hasn't got round to all of the commands yet.
+    ProcessorState getRequestedState () const;
+
+    // Message thread only. Takes a copy of the requested state for
+    // getStateInformation, which the host may call from any thread. Every
+    // setter that changes the requested state must call this.
+    void requestedStateChanged ();
+
+    // Message thread only. Applies a restored state, and passes it on to the
+    // editor if there is one.
+    void restoreState (ProcessorState state);
+
+    // Message thread only. Reads a saved state, and restores it if it's valid.
+    void restoreState (const void* data, size_t sizeInBytes);
+
+    // Restores states that the host handed to us on some other thread.
+    void handleAsyncUpdate () override;
+
+    // Audio thread. Applies any simple settings that have changed, and returns
+    // true if there were any.
+    bool applyLatestValues ();
+
+    // Audio thread. Makes the current settings available to getAppliedSynthState.
+    void publishSynthState ();
+
+    // A copy of the streaming options, taken when a load starts, so that the
+    // loading thread doesn't have to read them while they might be changing.
+    struct SampleLoadOptions
+    {
+        bool streamFromDisk;
+        double preloadSeconds;
+    };
+
+    SampleLoadOptions getSampleLoadOptions() const { return { streamFromDisk, streamPreloadSeconds }; }
+
+    // Returns the factory's sample, sharing it with any other instance that has
+    // already loaded it. Returns nullptr if the sample can't be read, or if
+    // loading was cancelled through the progress callback.
+    static std::shared_ptr<const OurSample> loadSample (const AudioFormatReaderFactory& factory,
+                                                        SamplePool& pool,
+                                                        AudioFormatManager& formatManager,
+                                                        SampleLoadOptions options,
+                                                        const OurSample::ProgressCallback& progress);
+
+    // Identifies a sample loaded with the given options, or returns an empty
+    // string if the factory can't say where its data comes from.
+    static String getSampleKey (const AudioFormatReaderFactory& factory, SampleLoadOptions options);
+
+    // Decodes the sample, or its head if it's going to be streamed.
+    static std::shared_ptr<const OurSample> loadSample (std::unique_ptr<AudioFormatReader> reader,
+                                                        SampleLoadOptions options,
+                                                        const OurSample::ProgressCallback& progress);
+
+    // Replaces the keymap, stopping every voice that was using the old one. The
+    // keymap was loaded either from the factory or from the zones, which match
+    // its own zones one for one. The key is the sample's key from getSampleKey,
+    // or empty if it doesn't have one. Message thread only.
+    void setKeymap (std::unique_ptr<AudioFormatReaderFactory> factory,
+                    std::vector<SampleZoneSource> zones,
+                    std::shared_ptr<const Keymap> keymap,
+                    const String& sampleKey);
+
+    // Message thread only. Builds the waveform summary of the sample that's just
+    // been swapped in, on the summariser's thread, and publishes it to
+    // getPeakPyramid when it's done. Reading all of a long streaming sample can
+    // take a while, and the sample plays in the meantime. The factory is the one
+    // the sample was loaded from.
+    void summariseLoadedSample (std::shared_ptr<const OurSample> sample,
+                                const AudioFormatReaderFactory* factory);
+
     CommandFifo<SamplerAudioProcessor> commands;
 
-    MemoryBlock memoryBlock;
-    std::unique_ptr<AudioFormatReaderFactory> readerFactory;
-    std::shared_ptr<OurSamplerSound> samplerSound = std::make_shared<OurSamplerSound>();
-    MPESynthesiser synthesiser;
+    LatestValue<double> centreFrequency { 440.0 };
+    LatestValue<int> interpolationMode { (int) InterpolationMode::linear };
+    LatestValue<bool> voiceStealingEnabled { false };
+    LatestValue<int> legacyPitchbendRange { 2 };
 
-    // This mutex is used to ensure we don't modify the processor state during
-    // a call to createEditor, which would cause the UI to become desynched
-    // with the real state of the processor.
-    SpinLock commandQueueMutex;
+    // Voices which the audio thread has finished with are passed back through
+    // this, and destroyed on the message thread.
+    RetireQueue<OurSamplerVoice> retiredVoices { 4 * PlaybackSnapshot::maxVoices };
 
-    enum { maxVoices = 200 };
+    SincTables sincTables;
+
+    std::shared_ptr<OurSamplerSound> samplerSound = std::make_shared<OurSamplerSound>();
+
+    // These are only touched on the message thread. The factory, the zones and
+    // the layout are the ones most recently passed to setSample, setZones and
+    // setMPEZoneLayout, so the factory or the zones may still be loading. The
+    // loaded factory or zones are the ones that are playing, which we fall back
+    // to if the load is cancelled. At most one of each pair is in use.
+    std::unique_ptr<AudioFormatReaderFactory> readerFactory, loadedReaderFactory;
+    std::vector<SampleZoneSource> requestedZones, loadedZones;
+    std::shared_ptr<const PeakPyramid> loadedPeakPyramid;
+    MPEZoneLayout zoneLayout;
+    bool streamFromDisk = false;
+    double streamPreloadSeconds = 1.0;
+
+    // Also message thread only. The setters compare against these, so that an
+    // editor restoring the state it was opened with doesn't rebuild anything.
+    String loadedSampleKey, pendingSampleKey;
+    int requestedNumVoices = 0;
+    bool requestedLegacyMode = false;
+    int requestedLegacyPitchbendRange = 0;
+    Range<int> requestedLegacyChannels;
+
+    // The default has to be one that the editor offers (see MPESettingsDataModel),
+    // or the first editor to open would change it.
+    enum
+    {
+        maxVoices = PlaybackSnapshot::maxVoices,
+        defaultNumVoices = 15
+    };
+
+    // The bank must outlive the synthesiser, because voices release their slots
+    // when they're destroyed, and the streamer must outlive the bank.
+    SampleStreamer streamer;
+    SamplerVoiceBank voiceBank { maxVoices, &streamer };
+    ParallelVoiceRenderer parallelRenderer;
+    SamplerSynthesiser synthesiser { voiceBank, parallelRenderer, maxVoices };
+
+    // The audio thread's settings, for getAppliedSynthState. Reading them never
+    // holds up the commands.
+    TripleBuffer<SynthStateSnapshot> synthStates;
+    uint32 nextSynthStateVersion = 1;
 
     // This is used for visualising the current playback position of each voice.
-    std::array<std::atomic<float>, maxVoices> playbackPositions;
+    TripleBuffer<PlaybackSnapshot> playbackSnapshots;
+
+    LoadMeter loadMeter;
+
+    // These may be used off the message thread, with the lock held. The saved
+    // state is what getStateInformation writes out, and the pending state is
+    // one which arrived off the message thread, waiting to be restored.
+    CriticalSection pendingStateLock;
+    std::shared_ptr<const ProcessorState> savedState;
+    MemoryBlock pendingState;
+
+    // Shared with every other instance. The last one to go takes the pool,
+    // and the samples it's caching, with it.
+    SharedResourcePointer<SamplePool> samplePool;
+
+    // Each format manager is only used on its loader's thread. The loaders come
+    // last, so that they're stopped before anything their jobs use is destroyed.
+    AudioFormatManager loaderFormatManager, summariserFormatManager;
+    SampleLoader summariser { "Waveform summariser" };
+    SampleLoader loader;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SamplerAudioProcessor)
 };
@@ -121,34 +379,49 @@ private:
 template<typename Element>
 void SamplerAudioProcessor::process (AudioBuffer<Element>& buffer, MidiBuffer& midiMessages)
 {
-    // Try to acquire a lock on the command queue.
-    // If we were successful, we pop all pending commands off the queue and
-    // apply them to the processor.
-    // If we weren't able to acquire the lock, it's because someone called
-    // createEditor, which requires that the processor data model stays in
-    // a valid state for the duration of the call.
-    const GenericScopedTryLock<SpinLock> lock (commandQueueMutex);
+    // The first time this thread is traced, it claims a ring, which may allocate.
+    SAMPLER_TRACE_THREAD ("Audio");
+
+    // In debug builds, this checks that nothing we track is freed in here. With
+    // SAMPLER_REALTIME_CHECKS, it also catches allocations, locks and blocking calls.
+    const RealtimeDebug::AudioThreadScope audioThreadScope;
 
-    if (lock.isLocked ())
-        commands.call (*this);
+    SAMPLER_TRACE_SCOPE ("process");
 
-    synthesiser.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples ());
+    loadMeter.beginBlock ();
 
-    auto loadedSamplerSound = samplerSound;
+    // Pop all pending commands off the queue and apply them to the processor.
+    const auto numCommands = commands.call (*this);
 
-    if (loadedSamplerSound->getSample () == nullptr)
-        return;
+    const auto valuesChanged = applyLatestValues ();
 
-    auto numVoices = synthesiser.getNumVoices ();
+    if (numCommands > 0 || valuesChanged)
+        publishSynthState ();
+
+    loadMeter.endStage (LoadMeter::commands);
 
-    // Update the current playback positions
-    for (auto i = 0; i < maxVoices; ++i)
     {
-        auto* voicePtr = dynamic_cast<OurSamplerVoice*> (synthesiser.getVoice (i));
+        SAMPLER_TRACE_SCOPE ("renderNextBlock");
 
-        if (i < numVoices && voicePtr != nullptr)
-            playbackPositions[(size_t) i] = static_cast<float> (voicePtr->getCurrentSamplePosition () / loadedSamplerSound->getSample ()->getSampleRate ());
-        else
-            playbackPositions[(size_t) i] = 0.0f;
+        // MPESynthesiser takes its note and voice locks on every block. Nothing
+        // else takes them while we're playing, so they're never contended. Our
+        // own rendering, which it calls back into, gets no such permission.
+        const RealtimeDebug::ScopedPermission synthesiserLocks (RealtimeDebug::Violation::lock);
+        synthesiser.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples ());
     }
+
+    loadMeter.endStage (LoadMeter::render);
+
+    // Publish the current playback positions. Only the voices which are actually
+    // sounding are visited, so this costs nothing when the synth is quiet.
+    const auto numActiveVoices = voiceBank.getNumActiveVoices ();
+    auto& snapshot = playbackSnapshots.getWriteBuffer ();
+    snapshot.numActiveVoices = numActiveVoices;
+
+    for (auto i = 0; i < snapshot.numActiveVoices; ++i)
+        snapshot.positionsInSeconds[(size_t) i] = (float) voiceBank.getPlaybackPositionSeconds (voiceBank.getActiveSlot (i));
+
+    playbackSnapshots.publish ();
+
+    loadMeter.endBlock (buffer.getNumSamples (), numActiveVoices);
 }
@@ -0,0 +1,70 @@
+#include "Semaphore.h"
+
+#if JUCE_WINDOWS
+
+// Otherwise windows.h defines min and max macros, which break calls such as
+// std::numeric_limits<>::max () in anything included after it.
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+
+ #include <windows.h>
+
+struct Semaphore::Pimpl
+{
+    Pimpl () : handle (CreateSemaphore (nullptr, 0, MAXLONG, nullptr)) {}
+    ~Pimpl () { CloseHandle (handle); }
+
+    HANDLE handle;
+};
+
+void Semaphore::signal () noexcept  { ReleaseSemaphore (pimpl->handle, 1, nullptr); }
+void Semaphore::wait () noexcept    { WaitForSingleObject (pimpl->handle, INFINITE); }
+
+#elif JUCE_MAC || JUCE_IOS
+
+ #include <dispatch/dispatch.h>
+
+// macOS doesn't support unnamed POSIX semaphores.
+struct Semaphore::Pimpl
+{
+    Pimpl () : semaphore (dispatch_semaphore_create (0)) {}
+    ~Pimpl () { dispatch_release (semaphore); }
+
+    dispatch_semaphore_t semaphore;
+};
+
+void Semaphore::signal () noexcept  { dispatch_semaphore_signal (pimpl->semaphore); }
+void Semaphore::wait () noexcept    { dispatch_semaphore_wait (pimpl->semaphore, DISPATCH_TIME_FOREVER); }
+
+#else
+
+ #include <cerrno>
+ #include <semaphore.h>
+
+struct Semaphore::Pimpl
+{
+    Pimpl () { sem_init (&semaphore, 0, 0); }
+    ~Pimpl () { sem_destroy (&semaphore); }
+
+    sem_t semaphore;
+};
+
+void Semaphore::signal () noexcept  { sem_post (&pimpl->semaphore); }
+
+void Semaphore::wait () noexcept
+{
+    // A signal handler can interrupt the wait without the count changing.
+    while (sem_wait (&pimpl->semaphore) != 0 && errno == EINTR)
+    {
+    }
+}
+
+#endif
+
+Semaphore::Semaphore () : pimpl (std::make_unique<Pimpl> ()) {}
+Semaphore::~Semaphore () = default;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+// A counting semaphore built on the platform's own, so that a thread can sleep
+// until another one wakes it.
+//
+// signal() never blocks or takes a lock. At worst it's a single system call to
+// wake the waiting thread, so the audio thread may call it.
+class Semaphore final
+{
+public:
+    Semaphore ();
+    ~Semaphore ();
+
+    // Any thread, including the audio thread.
+    void signal () noexcept;
+
+    // Blocks until the count is above zero, and then decrements it.
+    void wait () noexcept;
+
+private:
+    struct Pimpl;
+    std::unique_ptr<Pimpl> pimpl;
+
+    JUCE_DECLARE_NON_COPYABLE (Semaphore)
+};
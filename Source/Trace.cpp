@@ -0,0 +1,247 @@
+#include "Trace.h"
+
+#if SAMPLER_TRACING
+namespace
+{
+// At 375 blocks per second, with a handful of events per block, a ring holds a
+// few seconds of the audio thread.
+constexpr int maxThreads = 32;
+constexpr uint32 eventsPerThread = 1 << 13;
+
+// The fields are relaxed atomics so that a trace can be saved while the owning
+// thread carries on writing. Events which were overwritten while being copied
+// are detected and dropped afterwards.
+struct Event
+{
+    std::atomic<const char*> name {};
+    std::atomic<int64> ticks {};
+    std::atomic<Trace::Phase> phase {};
+};
+
+struct ThreadRing
+{
+    std::array<Event, eventsPerThread> events;
+    std::atomic<uint32> writeIndex { 0 };
+
+    // Where the current owner's events begin. The ones before it were left by
+    // a thread that has since exited, and are kept until the ring is reused.
+    std::atomic<uint32> firstIndex { 0 };
+    std::atomic<const char*> threadName { nullptr };
+    std::atomic<bool> inUse { false };
+};
+
+// Every ring is allocated up front, so that a thread's first event doesn't
+// allocate. They're all zeros, so they cost nothing until they're used. A
+// thread hands its ring back when it exits, and threads which start while
+// every ring is in use aren't recorded, only counted.
+std::array<ThreadRing, maxThreads> rings;
+std::atomic<int> numDroppedThreads { 0 };
+
+thread_local ThreadRing* currentRing = nullptr;
+thread_local bool hasRing = false;
+
+// Hands the ring back when its thread exits. It's only touched when a ring is
+// claimed, because registering its destructor may allocate, and the trivial
+// thread_locals above are all that recording needs.
+struct RingReleaser
+{
+    ~RingReleaser ()
+    {
+        currentRing = nullptr;
+
+        if (ring != nullptr)
+            ring->inUse.store (false, std::memory_order_release);
+    }
+
+    ThreadRing* ring = nullptr;
+};
+
+thread_local RingReleaser ringReleaser;
+
+ThreadRing* claimRing () noexcept
+{
+    for (auto& ring : rings)
+    {
+        auto expected = false;
+
+        if (ring.inUse.compare_exchange_strong (expected, true, std::memory_order_acquire))
+        {
+            ring.firstIndex.store (ring.writeIndex.load (std::memory_order_relaxed), std::memory_order_relaxed);
+            ring.threadName.store (nullptr, std::memory_order_relaxed);
+            return &ring;
+        }
+    }
+
+    ++numDroppedThreads;
+    return nullptr;
+}
+
+ThreadRing* getRing () noexcept
+{
+    if (! hasRing)
+    {
+        hasRing = true;
+        currentRing = claimRing ();
+
+        if (currentRing != nullptr)
+            ringReleaser.ring = currentRing;
+    }
+
+    return currentRing;
+}
+
+struct CopiedEvent
+{
+    const char* name;
+    int64 ticks;
+    Trace::Phase phase;
+};
+
+// Copies out the events that are still in the ring, oldest first.
+std::vector<CopiedEvent> copyEvents (const ThreadRing& ring)
+{
+    const auto end = ring.writeIndex.load (std::memory_order_acquire);
+    const auto start = end - jmin (end - ring.firstIndex.load (std::memory_order_relaxed), eventsPerThread);
+
+    std::vector<CopiedEvent> copied;
+    copied.reserve ((size_t) (end - start));
+
+    for (auto i = start; i != end; ++i)
+    {
+        const auto& event = ring.events[(size_t) (i % eventsPerThread)];
+        copied.push_back ({ event.name.load (std::memory_order_relaxed),
+                            event.ticks.load (std::memory_order_relaxed),
+                            event.phase.load (std::memory_order_relaxed) });
+    }
+
+    // Anything the thread has written since we started may have replaced some
+    // of the oldest events while we were copying them.
+    std::atomic_thread_fence (std::memory_order_acquire);
+    const auto endAfterCopy = ring.writeIndex.load (std::memory_order_relaxed);
+
+    if (endAfterCopy - start > eventsPerThread)
+    {
+        const auto numOverwritten = jmin ((size_t) (endAfterCopy - start - eventsPerThread), copied.size ());
+        copied.erase (copied.begin (), copied.begin () + (std::ptrdiff_t) numOverwritten);
+    }
+
+    return copied;
+}
+
+void writeEvent (OutputStream& out, bool& first, const String& json)
+{
+    out << (first ? "\n" : ",\n") << json;
+    first = false;
+}
+} // namespace
+
+void Trace::record (const char* name, Phase phase) noexcept
+{
+    auto* ring = getRing ();
+
+    if (ring == nullptr)
+        return;
+
+    const auto index = ring->writeIndex.load (std::memory_order_relaxed);
+    auto& event = ring->events[(size_t) (index % eventsPerThread)];
+
+    event.name.store (name, std::memory_order_relaxed);
+    event.ticks.store (Time::getHighResolutionTicks (), std::memory_order_relaxed);
+    event.phase.store (phase, std::memory_order_relaxed);
+
+    ring->writeIndex.store (index + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName (const char* name) noexcept
+{
+    if (auto* ring = getRing ())
+        ring->threadName.store (name, std::memory_order_relaxed);
+}
+
+bool Trace::write (OutputStream& out)
+{
+    std::vector<std::vector<CopiedEvent>> threads;
+
+    for (const auto& ring : rings)
+        threads.push_back (copyEvents (ring));
+
+    // Timestamps are in microseconds, from the oldest event we have.
+    auto origin = std::numeric_limits<int64>::max ();
+
+    for (const auto& events : threads)
+        if (! events.empty ())
+            origin = jmin (origin, events.front ().ticks);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    auto first = true;
+
+    if (const auto numDropped = numDroppedThreads.load (); numDropped > 0)
+        writeEvent (out, first, "{\"ph\":\"i\",\"pid\":1,\"tid\":0,\"ts\":0,\"s\":\"g\",\"name\":\""
+                                    + String (numDropped) + " thread(s) not recorded, because every ring was in use\"}");
+
+    for (auto i = 0; i < maxThreads; ++i)
+    {
+        // Rings which have never been used, or whose thread exited before
+        // recording anything.
+        if (threads[(size_t) i].empty () && ! rings[(size_t) i].inUse.load (std::memory_order_relaxed))
+            continue;
+
+        const auto tid = String (i + 1);
+        const auto* threadName = rings[(size_t) i].threadName.load (std::memory_order_relaxed);
+
+        writeEvent (out, first, "{\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"name\":\"thread_name\",\"args\":{\"name\":\""
+                                    + JSON::escapeString (threadName != nullptr ? String (threadName) : "Thread " + tid)
+                                    + "\"}}");
+
+        // The ring may have lost the begin events for the oldest end events.
+        auto depth = 0;
+
+        for (const auto& event : threads[(size_t) i])
+        {
+            if (event.phase == Phase::end && depth == 0)
+                continue;
+
+            depth += event.phase == Phase::begin ? 1 : (event.phase == Phase::end ? -1 : 0);
+
+            const auto micros = Time::highResolutionTicksToSeconds (event.ticks - origin) * 1.0e6;
+
+            writeEvent (out, first, "{\"ph\":\"" + String::charToString ((juce_wchar) event.phase)
+                                        + "\",\"pid\":1,\"tid\":" + tid
+                                        + ",\"ts\":" + String (micros, 3)
+                                        + ",\"name\":\"" + JSON::escapeString (event.name) + "\""
+                                        + (event.phase == Phase::instant ? ",\"s\":\"t\"}" : "}"));
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush ();
+    return true;
+}
+#else
+bool Trace::write (OutputStream&)
+{
+    return false;
+}
+#endif
+
+void Trace::writeToFileAsync (const File& file, std::function<void (bool)> onFinished)
+{
+    Thread::launch ([file, onFinished = std::move (onFinished)]
+    {
+        auto succeeded = false;
+
+        {
+            FileOutputStream out (file);
+
+            if (out.openedOk ())
+            {
+                out.setPosition (0);
+                out.truncate ();
+                succeeded = write (out) && out.getStatus ().wasOk ();
+            }
+        }
+
+        if (onFinished != nullptr)
+            MessageManager::callAsync ([onFinished, succeeded] { onFinished (succeeded); });
+    });
+}
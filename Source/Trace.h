@@ -0,0 +1,72 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+// A flight recorder for what the audio, message and loading threads were doing,
+// which can be saved as a Chrome trace and opened in Perfetto or chrome://tracing.
+//
+// Each thread records timestamped events into its own fixed-size ring, which
+// overwrites the oldest events once it's full, so a saved trace always covers
+// the last few seconds. Recording never allocates, locks or waits, apart from a
+// thread's first event, which claims a ring. A thread's ring is handed back when
+// it exits, and its events are kept until another thread claims it. Threads
+// which start while every ring is in use aren't recorded, and a saved trace
+// says how many there were. Event and thread names must be string literals,
+// because only the pointers are stored.
+//
+// Tracing is only compiled in when SAMPLER_TRACING=1. Otherwise, the macros
+// below expand to nothing at all.
+#ifndef SAMPLER_TRACING
+ #define SAMPLER_TRACING 0
+#endif
+
+#if SAMPLER_TRACING
+ // Records a begin event now, and the matching end event at the end of the scope.
+ #define SAMPLER_TRACE_SCOPE(name)  const Trace::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (name)
+
+ // Records an event with no duration.
+ #define SAMPLER_TRACE_INSTANT(name)  Trace::record (name, Trace::Phase::instant)
+
+ // Names the calling thread in saved traces.
+ #define SAMPLER_TRACE_THREAD(name)  Trace::setThreadName (name)
+#else
+ #define SAMPLER_TRACE_SCOPE(name)
+ #define SAMPLER_TRACE_INSTANT(name)
+ #define SAMPLER_TRACE_THREAD(name)
+#endif
+
+namespace Trace
+{
+enum class Phase : char
+{
+    begin = 'B',
+    end = 'E',
+    instant = 'i'
+};
+
+constexpr bool isEnabled () noexcept { return SAMPLER_TRACING != 0; }
+
+#if SAMPLER_TRACING
+void record (const char* name, Phase phase) noexcept;
+void setThreadName (const char* name) noexcept;
+
+struct Scope
+{
+    explicit Scope (const char* nameIn) noexcept : name (nameIn) { record (name, Phase::begin); }
+    ~Scope () { record (name, Phase::end); }
+
+    const char* const name;
+
+    JUCE_DECLARE_NON_COPYABLE (Scope)
+};
+#endif
+
+// Writes every event still in the rings as Chrome trace JSON. Returns false if
+// tracing isn't compiled in. The threads carry on recording while this runs.
+bool write (OutputStream& stream);
+
+// Does the same on a new thread, replacing the file, and calls onFinished on
+// the message thread with whether it succeeded.
+void writeToFileAsync (const File& file, std::function<void (bool)> onFinished = {});
+} // namespace Trace
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "juceHeader.h"
+using namespace juce;
+
+// A wait-free way of handing a stream of values from one thread to another,
+// where the reader only cares about the most recent value.
+//
+// There are three copies of the value: one owned by the writer, one owned by
+// the reader, and one in the middle. Publishing swaps the writer's copy with the
+// middle one, and reading swaps the middle copy with the reader's (but only if
+// something new was published in the meantime). Neither side ever waits for the
+// other, and neither side ever sees a partially-written value.
+//
+// There must only be a single writing thread, and a single reading thread.
+template <typename Value>
+class TripleBuffer final
+{
+public:
+    TripleBuffer () = default;
+
+    explicit TripleBuffer (const Value& initial)
+    {
+        buffers.fill (initial);
+    }
+
+    // Writer only. Returns the copy that the writer may freely modify, until
+    // the next call to publish().
+    Value& getWriteBuffer () noexcept { return buffers[(size_t) writeIndex]; }
+
+    // Writer only. Makes the contents of the write buffer available to the reader.
+    void publish () noexcept
+    {
+        writeIndex = middle.exchange (writeIndex | newDataFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader only. Picks up the most recently published value, if there is one.
+    // Returns true if the read buffer changed.
+    bool update () noexcept
+    {
+        if ((middle.load (std::memory_order_relaxed) & newDataFlag) == 0)
+            return false;
+
+        readIndex = middle.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // Reader only. Returns the value picked up by the last call to update().
+    const Value& getReadBuffer () const noexcept { return buffers[(size_t) readIndex]; }
+
+private:
+    enum { indexMask = 3, newDataFlag = 4 };
+
+    std::array<Value, 3> buffers {};
+    std::atomic<int> middle { 1 };
+    int writeIndex = 0;
+    int readIndex = 2;
+
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};